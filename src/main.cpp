@@ -17,6 +17,8 @@ int main()
 	//Load global symbols
 	debugf("Loading global symbols\n");
 	uso_init("rom:/global_syms.sym");
+	//Open modules through bundle if one was built
+	uso_init_bundle("rom:/usos.bundle");
 	//Load modules
 	debugf("Loading module 1\n");
 	uso_handle_t *uso_handle_1 = uso_open("rom:/module1.uso");
@@ -13,15 +13,34 @@ extern void __register_frame_info(void *ptr, void *object);
 extern void __deregister_frame_info(void *ptr);
 extern void __cxa_finalize(void *dso);
 extern char *__cxa_demangle(const char *mangled_name, char *output_buffer, size_t *length, int *status);
+//GP register value of main binary
+extern char _gp[];
+
+//Bases for decoding pointers in an FDE, layout must match libgcc
+struct dwarf_eh_bases {
+	void *tbase;
+	void *dbase;
+	void *func;
+};
+
+//libgcc FDE lookup, the main binary is linked with --wrap=_Unwind_Find_FDE
+extern const void *__real__Unwind_Find_FDE(void *pc, struct dwarf_eh_bases *bases);
 
 //Increments the value of ptr by base
 #define PTR_FIXUP(ptr, base) ((ptr) = (typeof(ptr))((uint8_t *)(base)+(uintptr_t)(ptr)))
 
-uso_symbol_table_t *__uso_global_symbol_table;
+uso_global_table_t *__uso_global_table;
+uso_bundle_header_t *__uso_bundle;
+uint32_t __uso_bundle_rom_addr;
 struct uso_handle_data *__uso_list_head;
 struct uso_handle_data *__uso_list_tail;
+struct uso_handle_data *__uso_cache_head;
+struct uso_handle_data *__uso_cache_tail;
+size_t __uso_cache_size;
+size_t __uso_cache_budget;
 void (*__uso_notify_add_func)();
 void (*__uso_notify_remove_func)();
+void (*__uso_profile_update_func)();
 bool __uso_initted;
 
 //to should be a power of 2
@@ -64,56 +83,68 @@ static uint32_t get_uso_ram_align(uso_load_info_t *uso_load)
 	}
 }
 
-static void insert_uso(struct uso_handle_data *handle)
+static void insert_uso(struct uso_handle_data **head, struct uso_handle_data **tail, struct uso_handle_data *handle)
 {
-	struct uso_handle_data *prev = __uso_list_tail;
+	struct uso_handle_data *prev = *tail;
 	//Make last handle next link to this handle
 	if(!prev) {
-		__uso_list_head = handle;
+		*head = handle;
 	} else {
 		prev->next = handle;
 	}
 	//Set up new handle links
 	handle->prev = prev;
 	handle->next = NULL;
-	__uso_list_tail = handle; //Append handle to end of list
+	*tail = handle; //Append handle to end of list
 }
 
-static void remove_uso(struct uso_handle_data *handle)
+static void remove_uso(struct uso_handle_data **head, struct uso_handle_data **tail, struct uso_handle_data *handle)
 {
 	struct uso_handle_data *next = handle->next;
 	struct uso_handle_data *prev = handle->prev;
 	//Relink next handle to link to previous handle
 	if(!next) {
-		__uso_list_tail = prev;
+		*tail = prev;
 	} else {
 		next->prev = prev;
 	}
 	//Relink previous handle to link to next handle
 	if(!prev) {
-		__uso_list_head = next;
+		*head = next;
 	} else {
 		prev->next = next;
 	}
 }
 
-static int symbol_compare(const void *arg1, const void *arg2)
-{
-	const uso_symbol_t *sym1 = arg1;
-	const uso_symbol_t *sym2 = arg2;
-	//Compare symbol names
-	return strcmp(sym1->name, sym2->name);
-}
-
-static void *search_symbol_table(uso_symbol_table_t *table, const char *name)
+static uso_symbol_t *find_symbol(uso_symbol_table_t *table, const char *name)
 {
 	if(!table || table->length == 0) {
 		//Return NULL for empty symbol tables
 		return NULL;
 	}
-	//Do symbol table search
-	uso_symbol_t cmp_symbol = { name, NULL, 0, 0 };
-	uso_symbol_t *result = bsearch(&cmp_symbol, table->data, table->length, sizeof(uso_symbol_t), symbol_compare);
+	//Binary search symbol table resolving names relative to the table
+	uint32_t min = 0;
+	uint32_t max = table->length;
+	while(min < max) {
+		uint32_t mid = (min+max)/2;
+		uso_symbol_t *symbol = &table->data[mid];
+		int cmp = strcmp(name, __uso_symbol_get_name(table, symbol));
+		if(cmp == 0) {
+			//Found symbol
+			return symbol;
+		} else if(cmp < 0) {
+			max = mid;
+		} else {
+			min = mid+1;
+		}
+	}
+	//Return NULL for not found
+	return NULL;
+}
+
+static void *search_symbol_table(uso_symbol_table_t *table, const char *name)
+{
+	uso_symbol_t *result = find_symbol(table, name);
 	if(result) {
 		//Return pointer if symbol search succeeded
 		return result->ptr;
@@ -122,6 +153,129 @@ static void *search_symbol_table(uso_symbol_table_t *table, const char *name)
 	return NULL;
 }
 
+//Hash must match make_global_syms
+static void hash_name(const char *name, uint32_t seed, uint32_t *h1, uint32_t *h2)
+{
+	uint32_t hash1 = 0x811C9DC5 ^ seed;
+	uint32_t hash2 = 0x9E3779B9 + seed;
+	while(*name) {
+		uint8_t c = *name++;
+		hash1 = (hash1 ^ c) * 0x01000193;
+		hash2 = (hash2 ^ c) * 0x5BD1E995;
+	}
+	*h1 = hash1;
+	*h2 = hash2;
+}
+
+static uint32_t hash_mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85EBCA6B;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35;
+	h ^= h >> 16;
+	return h;
+}
+
+static uint32_t read_varint(const uint8_t **ptr)
+{
+	//Read 7 bits per byte until top bit is clear
+	uint32_t value = 0;
+	uint32_t shift = 0;
+	uint8_t byte;
+	do {
+		byte = *(*ptr)++;
+		value |= (byte & 0x7F) << shift;
+		shift += 7;
+	} while(byte & 0x80);
+	return value;
+}
+
+static bool global_symbol_name_equals(uso_global_table_t *table, uint32_t index, const char *name)
+{
+	uint32_t *restarts = (uint32_t *)((uint8_t *)table+table->restarts_ofs);
+	const uint8_t *names = (uint8_t *)table+table->names_ofs;
+	const uint8_t *ptr = names+restarts[index/USO_GLOBAL_RESTART_INTERVAL];
+	//Track length of prefix of name matching each decoded name instead of rebuilding names
+	uint32_t match_len = 0;
+	uint32_t name_len = 0;
+	for(uint32_t i=index-(index%USO_GLOBAL_RESTART_INTERVAL); i<=index; i++) {
+		uint32_t shared = read_varint(&ptr);
+		uint32_t suffix_len = read_varint(&ptr);
+		//Names sharing more than the matched prefix with the previous name still mismatch at the same place
+		if(shared <= match_len) {
+			match_len = shared;
+			for(uint32_t j=0; j<suffix_len && name[match_len] == ptr[j]; j++) {
+				match_len++;
+			}
+		}
+		name_len = shared+suffix_len;
+		ptr += suffix_len;
+	}
+	return match_len == name_len && name[match_len] == 0;
+}
+
+static void *search_global_symbols(const char *name)
+{
+	uso_global_table_t *table = __uso_global_table;
+	if(table->num_syms == 0) {
+		//Return NULL for empty global symbol table
+		return NULL;
+	}
+	//Find slot of symbol with one hash
+	uint32_t h1, h2;
+	hash_name(name, table->hash_seed, &h1, &h2);
+	uint32_t *buckets = (uint32_t *)((uint8_t *)table+table->buckets_ofs);
+	uint32_t *slots = (uint32_t *)((uint8_t *)table+table->slots_ofs);
+	uint32_t displacement = buckets[hash_mix(h1) % table->num_buckets];
+	uint32_t index = slots[hash_mix(h2+(displacement*0x9E3779B9)) % table->num_syms];
+	//Verify symbol name as names not in the table also hash to a slot
+	if(global_symbol_name_equals(table, index, name)) {
+		uint32_t *addrs = (uint32_t *)((uint8_t *)table+table->addrs_ofs);
+		return (void *)addrs[index];
+	}
+	//Return NULL for not found
+	return NULL;
+}
+
+static const char *get_bundle_name(const char *filename)
+{
+	//Bundle entries are named by path relative to filesystem root
+	static const char prefix[] = "rom:/";
+	if(strncmp(filename, prefix, sizeof(prefix)-1) != 0) {
+		return NULL;
+	}
+	return filename+sizeof(prefix)-1;
+}
+
+static uso_bundle_entry_t *find_bundle_entry(const char *filename)
+{
+	uso_bundle_header_t *bundle = __uso_bundle;
+	const char *name = get_bundle_name(filename);
+	if(!bundle || !name) {
+		return NULL;
+	}
+	//Search only entries in bucket of name hash
+	uint32_t hash, unused;
+	hash_name(name, 0, &hash, &unused);
+	uint32_t bucket = hash & (bundle->num_buckets-1);
+	uint32_t *buckets = (uint32_t *)((uint8_t *)bundle+bundle->buckets_ofs);
+	uso_bundle_entry_t *entries = (uso_bundle_entry_t *)((uint8_t *)bundle+bundle->entries_ofs);
+	for(uint32_t i=buckets[bucket]; i<buckets[bucket+1]; i++) {
+		if(entries[i].name_hash == hash && strcmp((char *)bundle+entries[i].name_ofs, name) == 0) {
+			return &entries[i];
+		}
+	}
+	return NULL;
+}
+
+static void read_rom(void *dst, uint32_t rom_addr, uint32_t size)
+{
+	//Cached copy of destination must be written back and dropped so it can't overwrite DMAed data
+	data_cache_hit_writeback_invalidate(dst, size);
+	dma_read(dst, rom_addr, size);
+}
+
 static void *search_loaded_symbols(const char *name, bool search_global)
 {
 	//Search in every loaded USO symbol table
@@ -136,25 +290,23 @@ static void *search_loaded_symbols(const char *name, bool search_global)
 	}
 	//Try global search if possible
 	if(search_global) {
-		return search_symbol_table(__uso_global_symbol_table, name);
+		return search_global_symbols(name);
 	}
 	//Return NULL
 	return NULL;
 }
 
-static void fixup_symbol_table_names(uso_symbol_table_t *table)
-{
-	for(uint32_t i=0; i<table->length; i++) {
-		PTR_FIXUP(table->data[i].name, table);
-	}
-}
-
 static void fixup_section_table(uso_section_t *sections, void *noload_base, uint16_t num_sections)
 {
 	uint8_t *noload = noload_base;
 	//Skip section 0 as that is the dummy section
 	for(uint16_t i=1; i<num_sections; i++) {
-		if(sections[i].data) {
+		if(sections[i].data_align & USO_SECTION_UNWIND) {
+			//Unwind sections left in ROM are placed once they are read
+			sections[i].data = NULL;
+			sections[i].internal_relocs = NULL;
+			sections[i].external_relocs = NULL;
+		} else if(sections[i].data) {
 			//Fixup section data pointer
 			PTR_FIXUP(sections[i].data, sections);
 			//Fixup section relocation pointer when not NULL
@@ -166,8 +318,9 @@ static void fixup_section_table(uso_section_t *sections, void *noload_base, uint
 			}
 		} else {
 			//Align noload pointer (do not change when alignment is 0)
-			if(sections[i].data_align > 0) {
-				noload = roundup_ptr(noload, sections[i].data_align);
+			uint32_t align = sections[i].data_align & USO_SECTION_ALIGN_MASK;
+			if(align > 0) {
+				noload = roundup_ptr(noload, align);
 			}
 			sections[i].data = noload;
 			//Move to next noload section
@@ -180,28 +333,84 @@ static void fixup_section_table(uso_section_t *sections, void *noload_base, uint
 
 static void fixup_export_syms(uso_symbol_table_t *sym_table, uso_section_t *sections)
 {
-	//Symbol names must be fixed up before symbol search
-	fixup_symbol_table_names(sym_table);
 	//Fixup export symbol pointers
 	for(uint32_t i=0; i<sym_table->length; i++) {
 		PTR_FIXUP(sym_table->data[i].ptr, sections[sym_table->data[i].section].data);
 	}
 }
 
-static bool fixup_import_syms(uso_symbol_table_t *sym_table)
+static uso_header_t *find_module(uint16_t module_id, uint32_t set_fingerprint)
+{
+	//Search for loaded USO with module ID from same module set
+	struct uso_handle_data *curr = __uso_list_head;
+	while(curr) {
+		if(curr->uso->module_id == module_id && curr->uso->module_set_fingerprint == set_fingerprint) {
+			return curr->uso;
+		}
+		curr = curr->next;
+	}
+	return NULL;
+}
+
+static void *resolve_ordinal_import(uso_header_t *uso, uso_symbol_t *symbol)
+{
+	//Find providing module
+	uso_header_t *provider = find_module(symbol->section, uso->module_set_fingerprint);
+	if(!provider || !provider->export_syms) {
+		return NULL;
+	}
+	//Index into provider export symbols
+	uint32_t ordinal = (uint32_t)symbol->ptr;
+	if(ordinal >= provider->export_syms->length) {
+		return NULL;
+	}
+	return provider->export_syms->data[ordinal].ptr;
+}
+
+static void print_unresolved_import(uso_header_t *uso, uint32_t index)
+{
+	uso_symbol_t *symbol = &uso->import_syms->data[index];
+	const char *name = __uso_symbol_get_name(uso->import_syms, symbol);
+	if(symbol->section != 0) {
+		//Ordinal imports only have names in the debug table
+		if(!uso->import_debug_syms) {
+			debugf("Unresolved external symbol %u of module %u.\n", (unsigned int)symbol->ptr, (unsigned int)symbol->section);
+			return;
+		}
+		name = __uso_symbol_get_name(uso->import_debug_syms, &uso->import_debug_syms->data[index]);
+	}
+	debugf("Unresolved external symbol %s (%s).\n", name, __cxa_demangle(name, NULL, NULL, NULL));
+}
+
+static bool fixup_import_syms(uso_header_t *uso)
 {
+	uso_symbol_table_t *sym_table = uso->import_syms;
 	//Symbol resolution starts succeessful
 	bool result = true;
-	//Symbol names must be fixed up before symbol search
-	fixup_symbol_table_names(sym_table);
 	for(uint32_t i=0; i<sym_table->length; i++) {
-		//Try to resolve symbol names in symbol tables
-		void *ptr = search_loaded_symbols(sym_table->data[i].name, true);
+		void *ptr;
+		if(sym_table->data[i].section != 0) {
+			//Resolve symbols bound by ordinal by indexing provider
+			ptr = resolve_ordinal_import(uso, &sym_table->data[i]);
+		} else {
+			//Try to resolve symbol names in symbol tables
+			const char *name = __uso_symbol_get_name(sym_table, &sym_table->data[i]);
+			ptr = search_loaded_symbols(name, true);
+			//Vague linkage symbols are also exported and fall back to this USO's copy
+			//The export is pointed at the copy in use so USOs loaded later bind to the same one
+			uso_symbol_t *export_sym = find_symbol(uso->export_syms, name);
+			if(export_sym) {
+				if(ptr) {
+					export_sym->ptr = ptr;
+				} else {
+					ptr = export_sym->ptr;
+				}
+			}
+		}
 		if(!__uso_is_symbol_weak(&sym_table->data[i]) && !ptr) {
 			//Output error if symbol is not resolved and not weak
 			//Also mark symbol resolution as failed
-			debugf("Unresolved external symbol %s (%s).\n", sym_table->data[i].name, 
-				__cxa_demangle(sym_table->data[i].name, NULL, NULL, NULL));
+			print_unresolved_import(uso, i);
 			result = false;
 		}
 		//Write pointer to symbol
@@ -302,6 +511,15 @@ static void apply_uso_relocs(uso_header_t *uso, uint16_t target_section, bool in
 			}
 			break;
 			
+			case R_MIPS_GPREL16:
+			//Relocate access to small data of main binary through GP
+			{
+				int32_t gp_offset = (int16_t)(*target & 0xFFFF)+sym_addr-(uint32_t)_gp;
+				assertf(gp_offset >= -0x8000 && gp_offset <= 0x7FFF, "GP-relative relocation target %08x is not in small data of main binary.\n", (unsigned int)sym_addr);
+				*target = (*target & 0xFFFF0000)|(gp_offset & 0xFFFF);
+			}
+			break;
+			
 			default:
 			//Throw up an error if invalid relocation types are hit
 				assertf(0, "Invalid relocation type %d.\n", type);
@@ -323,8 +541,11 @@ static void flush_uso(uso_header_t *uso)
 {
 	//Invalidate cache for each non-dummy section
 	for(uint16_t i=1; i<uso->num_sections; i++) {
-		data_cache_hit_writeback_invalidate(uso->sections[i].data, uso->sections[i].data_size);
-		inst_cache_hit_invalidate(uso->sections[i].data, uso->sections[i].data_size);
+		//Unwind sections left in ROM may not be placed yet
+		if(uso->sections[i].data) {
+			data_cache_hit_writeback_invalidate(uso->sections[i].data, uso->sections[i].data_size);
+			inst_cache_hit_invalidate(uso->sections[i].data, uso->sections[i].data_size);
+		}
 	}
 }
 
@@ -338,9 +559,12 @@ static bool fixup_uso(uso_header_t *uso, void *noload_base)
 		PTR_FIXUP(uso->export_syms, uso);
 		fixup_export_syms(uso->export_syms, uso->sections);
 	}
+	if(uso->import_debug_syms) {
+		PTR_FIXUP(uso->import_debug_syms, uso);
+	}
 	if(uso->import_syms) {
 		PTR_FIXUP(uso->import_syms, uso);
-		if(!fixup_import_syms(uso->import_syms)) {
+		if(!fixup_import_syms(uso)) {
 			return false;
 		}
 	}
@@ -349,6 +573,69 @@ static bool fixup_uso(uso_header_t *uso, void *noload_base)
 	return true;
 }
 
+static void link_unwind_data(struct uso_handle_data *handle, void *unwind_data)
+{
+	uso_header_t *uso = handle->uso;
+	//Unwind sections keep the file layout relative to each other
+	uint8_t *base = (uint8_t *)unwind_data-uso->unwind_ofs+((uint8_t *)uso->sections-(uint8_t *)uso);
+	for(uint16_t i=1; i<uso->num_sections; i++) {
+		uso_section_t *file_section = &handle->file_sections[i];
+		if(file_section->data_align & USO_SECTION_UNWIND) {
+			uso_section_t *section = &uso->sections[i];
+			*section = *file_section;
+			PTR_FIXUP(section->data, base);
+			if(section->internal_relocs) {
+				PTR_FIXUP(section->internal_relocs, base);
+			}
+			if(section->external_relocs) {
+				PTR_FIXUP(section->external_relocs, base);
+			}
+		}
+	}
+	//Relocate once every unwind section is placed as they point to each other
+	for(uint16_t i=1; i<uso->num_sections; i++) {
+		if(handle->file_sections[i].data_align & USO_SECTION_UNWIND) {
+			apply_uso_relocs(uso, i, true);
+			apply_uso_relocs(uso, i, false);
+		}
+	}
+	//Function offsets in FDE search table assume unwind sections directly follow the rest of the USO
+	uso_eh_frame_hdr_t *hdr = uso->sections[uso->eh_frame_hdr_section].data;
+	int32_t func_ofs_delta = ((uint8_t *)uso+uso->unwind_ofs)-(uint8_t *)unwind_data;
+	for(uint32_t i=0; i<hdr->num_entries; i++) {
+		hdr->entries[i].func_ofs += func_ofs_delta;
+	}
+	handle->unwind_data = unwind_data;
+}
+
+static void drop_unwind_data(struct uso_handle_data *handle)
+{
+	uso_header_t *uso = handle->uso;
+	for(uint16_t i=1; i<uso->num_sections; i++) {
+		if(handle->file_sections[i].data_align & USO_SECTION_UNWIND) {
+			uso->sections[i].data = NULL;
+			uso->sections[i].internal_relocs = NULL;
+			uso->sections[i].external_relocs = NULL;
+		}
+	}
+	free(handle->unwind_data);
+	handle->unwind_data = NULL;
+}
+
+static bool drop_unused_unwind_data(void)
+{
+	//Unwind data read from ROM can be read again when it is next needed
+	struct uso_handle_data *curr = __uso_list_head;
+	while(curr) {
+		if(curr->unwind_data && curr->unwind_rom_addr != 0) {
+			drop_unwind_data(curr);
+			return true;
+		}
+		curr = curr->next;
+	}
+	return false;
+}
+
 static void run_ctors(uso_header_t *uso)
 {
 	uso_section_t *ctor_section = &uso->sections[uso->ctors_section];
@@ -389,9 +676,9 @@ static void run_dtors(uso_header_t *uso)
 
 static void start_uso(uso_header_t *uso, uint32_t *frameobj_data)
 {
-	//Register exception frames first
+	//Register exception frames first unless they are found through the USO search table
 	uso_section_t *ehframe_section = &uso->sections[uso->eh_frame_section];
-	if(ehframe_section->data && ehframe_section->data_size > 0) {
+	if(uso->eh_frame_hdr_section == 0 && ehframe_section->data && ehframe_section->data_size > 0) {
 		__register_frame_info(ehframe_section->data, frameobj_data);
 	}
 	run_ctors(uso);
@@ -412,7 +699,7 @@ static void end_uso(uso_header_t *uso)
 	}
 	run_dtors(uso);
 	//Deregister exception frames last
-	if(ehframe_section->data && ehframe_section->data_size > 0) {
+	if(uso->eh_frame_hdr_section == 0 && ehframe_section->data && ehframe_section->data_size > 0) {
 		__deregister_frame_info(ehframe_section->data);
 	}
 }
@@ -432,6 +719,21 @@ static bool is_ptr_inside_uso(uso_header_t *header, void *ptr)
 	return false;
 }
 
+static bool is_uso_ordinal_provider(uso_header_t *uso, uso_header_t *provider)
+{
+	//Modules outside of a module set are never bound by ordinal
+	if(!uso->import_syms || provider->module_id == 0 || uso->module_set_fingerprint != provider->module_set_fingerprint) {
+		return false;
+	}
+	//Ordinal imports are sorted first
+	for(uint32_t i=0; i<uso->import_syms->length && uso->import_syms->data[i].section != 0; i++) {
+		if(uso->import_syms->data[i].section == provider->module_id && uso->import_syms->data[i].ptr) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static bool is_uso_closeable(struct uso_handle_data *handle)
 {
 	uso_symbol_table_t *export_syms = handle->uso->export_syms; //Save handle to uso export symbols
@@ -443,9 +745,15 @@ static bool is_uso_closeable(struct uso_handle_data *handle)
 			curr = curr->next;
 			continue;
 		}
+		//The USO cannot be closed if another loaded USO imports a symbol from it by ordinal
+		if(is_uso_ordinal_provider(curr->uso, handle->uso)) {
+			return false;
+		}
 		//The USO cannot be closed if another loaded USO imports a symbol from its symbol table
+		//Vague linkage imports of the same name bound to another copy don't keep it loaded
 		for(uint32_t i=0; i<export_syms->length; i++) {
-			if(search_symbol_table(curr->uso->import_syms, export_syms->data[i].name)) {
+			void *ptr = search_symbol_table(curr->uso->import_syms, __uso_symbol_get_name(export_syms, &export_syms->data[i]));
+			if(ptr && is_ptr_inside_uso(handle->uso, ptr)) {
 				return false;
 			}
 		}
@@ -455,6 +763,280 @@ static bool is_uso_closeable(struct uso_handle_data *handle)
 	return true;
 }
 
+static bool is_uso_bound_to(uso_header_t *uso, uso_header_t *provider)
+{
+	if(!uso->import_syms) {
+		return false;
+	}
+	//Check for imports resolved to symbols inside provider
+	for(uint32_t i=0; i<uso->import_syms->length; i++) {
+		void *ptr = uso->import_syms->data[i].ptr;
+		if(ptr && is_ptr_inside_uso(provider, ptr)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool is_uso_link_current(uso_header_t *uso)
+{
+	if(!uso->import_syms) {
+		return true;
+	}
+	for(uint32_t i=0; i<uso->import_syms->length; i++) {
+		uso_symbol_t *symbol = &uso->import_syms->data[i];
+		if(!symbol->ptr) {
+			//Unresolved weak imports go stale once a provider is loaded
+			//Ordinals of unresolved imports are lost so any loaded provider module counts
+			if(symbol->section != 0) {
+				if(find_module(symbol->section, uso->module_set_fingerprint)) {
+					return false;
+				}
+			} else if(search_loaded_symbols(__uso_symbol_get_name(uso->import_syms, symbol), true)) {
+				return false;
+			}
+		} else if(symbol->section == 0 && is_ptr_inside_uso(uso, symbol->ptr)) {
+			//Vague linkage imports bound to this USO's own copy go stale once another copy is loaded
+			void *ptr = search_loaded_symbols(__uso_symbol_get_name(uso->import_syms, symbol), true);
+			if(ptr && ptr != symbol->ptr) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool is_section_snapshotted(struct uso_handle_data *handle, uso_section_t *section)
+{
+	//Only writable sections loaded from the file need their data restored
+	//Unwind sections are outside the USO image and may not be placed at all
+	uint8_t *noload_start = (uint8_t *)handle->uso+handle->noload_ofs;
+	if(section->data_align & USO_SECTION_UNWIND) {
+		return false;
+	}
+	return (section->data_align & USO_SECTION_WRITABLE) && (uint8_t *)section->data < noload_start;
+}
+
+static void snapshot_uso_data(struct uso_handle_data *handle)
+{
+	uso_header_t *uso = handle->uso;
+	uint32_t size = 0;
+	for(uint16_t i=1; i<uso->num_sections; i++) {
+		if(is_section_snapshotted(handle, &uso->sections[i])) {
+			size += uso->sections[i].data_size;
+		}
+	}
+	handle->data_snapshot = NULL;
+	handle->data_snapshot_size = size;
+	if(size != 0) {
+		handle->data_snapshot = malloc(size);
+		if(!handle->data_snapshot) {
+			//Can't cache USO without its initial data
+			handle->cacheable = false;
+			return;
+		}
+	}
+	//Copy writable section data in section order
+	uint8_t *snapshot = handle->data_snapshot;
+	for(uint16_t i=1; i<uso->num_sections; i++) {
+		uso_section_t *section = &uso->sections[i];
+		if(is_section_snapshotted(handle, section)) {
+			memcpy(snapshot, section->data, section->data_size);
+			snapshot += section->data_size;
+		}
+	}
+	handle->cacheable = true;
+}
+
+static void restore_uso_data(struct uso_handle_data *handle)
+{
+	uso_header_t *uso = handle->uso;
+	uint8_t *snapshot = handle->data_snapshot;
+	uint8_t *noload_start = (uint8_t *)uso+handle->noload_ofs;
+	uint8_t *noload_end = (uint8_t *)uso+handle->ram_size;
+	for(uint16_t i=1; i<uso->num_sections; i++) {
+		uso_section_t *section = &uso->sections[i];
+		if(is_section_snapshotted(handle, section)) {
+			//Restore data as it was after linking
+			memcpy(section->data, snapshot, section->data_size);
+			snapshot += section->data_size;
+		} else if((uint8_t *)section->data >= noload_start && (uint8_t *)section->data < noload_end) {
+			//Noload sections start zeroed
+			memset(section->data, 0, section->data_size);
+		}
+	}
+}
+
+static size_t get_cached_uso_size(struct uso_handle_data *handle)
+{
+	//Unwind data of USOs outside ROM stays in memory while cached
+	size_t size = handle->ram_size+handle->data_snapshot_size;
+	if(handle->unwind_data) {
+		size += handle->uso->unwind_size;
+	}
+	return size;
+}
+
+static void free_uso(struct uso_handle_data *handle)
+{
+	free(handle->unwind_data);
+	free(handle->file_sections);
+	free(handle->data_snapshot);
+	free(handle->uso);
+	free(handle);
+}
+
+static void evict_cached_uso(struct uso_handle_data *handle)
+{
+	remove_uso(&__uso_cache_head, &__uso_cache_tail, handle);
+	__uso_cache_size -= get_cached_uso_size(handle);
+	free_uso(handle);
+}
+
+static void evict_bound_usos(struct uso_handle_data *provider)
+{
+	//Cached USOs bound to provider can't be reopened once provider is closed
+	struct uso_handle_data *curr = __uso_cache_head;
+	while(curr) {
+		struct uso_handle_data *next = curr->next;
+		if(is_uso_bound_to(curr->uso, provider->uso)) {
+			evict_cached_uso(curr);
+		}
+		curr = next;
+	}
+}
+
+static bool cache_uso(struct uso_handle_data *handle)
+{
+	size_t size = get_cached_uso_size(handle);
+	if(!handle->cacheable || size > __uso_cache_budget) {
+		return false;
+	}
+	//Evict least recently closed USOs until USO fits in budget
+	while(__uso_cache_size+size > __uso_cache_budget) {
+		evict_cached_uso(__uso_cache_head);
+	}
+	insert_uso(&__uso_cache_head, &__uso_cache_tail, handle);
+	__uso_cache_size += size;
+	return true;
+}
+
+static struct uso_handle_data *find_cached_uso(const char *filename)
+{
+	struct uso_handle_data *curr = __uso_cache_head;
+	while(curr) {
+		if(strcmp(curr->name, filename) == 0) {
+			return curr;
+		}
+		curr = curr->next;
+	}
+	return NULL;
+}
+
+static void reopen_cached_uso(struct uso_handle_data *handle)
+{
+	remove_uso(&__uso_cache_head, &__uso_cache_tail, handle);
+	__uso_cache_size -= get_cached_uso_size(handle);
+	//USO is still linked so only its data needs to be reset
+	restore_uso_data(handle);
+	flush_uso(handle->uso);
+	handle->ref_count = 1;
+	insert_uso(&__uso_list_head, &__uso_list_tail, handle);
+	if(__uso_notify_add_func) {
+		__uso_notify_add_func();
+	}
+	if(__uso_profile_update_func) {
+		__uso_profile_update_func();
+	}
+	start_uso(handle->uso, handle->frameobj_data);
+}
+
+static void *alloc_uso_memory(uint32_t align, uint32_t size, bool drop_unwind)
+{
+	void *ptr = memalign(align, size);
+	//Make room by evicting least recently closed USOs then dropping unwind data of loaded USOs
+	while(!ptr) {
+		if(__uso_cache_head) {
+			evict_cached_uso(__uso_cache_head);
+		} else if(!drop_unwind || !drop_unused_unwind_data()) {
+			break;
+		}
+		ptr = memalign(align, size);
+	}
+	return ptr;
+}
+
+static uint32_t get_uso_rom_addr(const char *filename, uso_bundle_entry_t *bundle_entry)
+{
+	//USOs in bundle or stored directly in DFS can be read by DMA
+	if(bundle_entry) {
+		return __uso_bundle_rom_addr+bundle_entry->data_ofs;
+	}
+	const char *name = get_bundle_name(filename);
+	return name ? dfs_rom_addr(name) : 0;
+}
+
+static bool load_unwind_data(struct uso_handle_data *handle)
+{
+	uso_header_t *uso = handle->uso;
+	//Unwind data must not move while an exception is unwound as the personality routine keeps pointers into it
+	void *unwind_data = alloc_uso_memory(USO_UNWIND_ALIGN, uso->unwind_size, false);
+	if(!unwind_data) {
+		return false;
+	}
+	read_rom(unwind_data, handle->unwind_rom_addr, uso->unwind_size);
+	link_unwind_data(handle, unwind_data);
+	return true;
+}
+
+static const void *find_uso_fde(uso_header_t *uso, void *pc, struct dwarf_eh_bases *bases)
+{
+	uso_eh_frame_hdr_t *hdr = uso->sections[uso->eh_frame_hdr_section].data;
+	//Binary search for last FDE starting at or before PC
+	uint32_t min = 0;
+	uint32_t max = hdr->num_entries;
+	while(min < max) {
+		uint32_t mid = (min+max)/2;
+		if((uint8_t *)hdr+hdr->entries[mid].func_ofs <= (uint8_t *)pc) {
+			min = mid+1;
+		} else {
+			max = mid;
+		}
+	}
+	if(min == 0) {
+		return NULL;
+	}
+	uint8_t *func = (uint8_t *)hdr+hdr->entries[min-1].func_ofs;
+	uint8_t *fde = (uint8_t *)hdr+hdr->entries[min-1].fde_ofs;
+	//Function size follows length, CIE pointer, and 4-byte function start
+	if((uint8_t *)pc >= func+*(uint32_t *)(fde+12)) {
+		return NULL;
+	}
+	bases->tbase = NULL;
+	bases->dbase = NULL;
+	bases->func = func;
+	return fde;
+}
+
+const void *__wrap__Unwind_Find_FDE(void *pc, struct dwarf_eh_bases *bases)
+{
+	//USOs with a search table are searched here and everything else through libgcc
+	struct uso_handle_data *curr = __uso_list_head;
+	while(curr) {
+		uso_header_t *uso = curr->uso;
+		if(uso->eh_frame_hdr_section != 0 && (uint8_t *)pc >= (uint8_t *)uso && (uint8_t *)pc < (uint8_t *)uso+curr->ram_size) {
+			//Unwind sections left in ROM are read the first time an exception passes through USO
+			if(!curr->unwind_data && uso->unwind_size != 0 && !load_unwind_data(curr)) {
+				debugf("Not enough memory to read unwind data of USO %s.\n", curr->name);
+				return NULL;
+			}
+			return find_uso_fde(uso, pc, bases);
+		}
+		curr = curr->next;
+	}
+	return __real__Unwind_Find_FDE(pc, bases);
+}
+
 void uso_init(const char *global_sym_filename)
 {
 	//Open global symbol file
@@ -463,18 +1045,57 @@ void uso_init(const char *global_sym_filename)
 	//Calculate size of global symbols
 	fseek(file, 0, SEEK_END);
 	size_t size = ftell(file);
-	__uso_global_symbol_table = malloc(size);
-	//Read global symbols
+	__uso_global_table = malloc(size);
+	//Read global symbols in one pass
+	//No fixups are needed as names are resolved relative to the table on lookup
 	fseek(file, 0, SEEK_SET);
-	fread(__uso_global_symbol_table, size, 1, file);
+	fread(__uso_global_table, size, 1, file);
 	fclose(file);
-	fixup_symbol_table_names(__uso_global_symbol_table);
 	//Initialize globals
 	__uso_list_head = __uso_list_tail = NULL;
+	__uso_cache_head = __uso_cache_tail = NULL;
+	__uso_cache_size = 0;
 	__uso_initted = true;
 	//Clean up resources
 }
 
+bool uso_init_bundle(const char *bundle_filename)
+{
+	//Bundle is read by DMA so only its ROM address is needed from filesystem
+	const char *name = get_bundle_name(bundle_filename);
+	uint32_t rom_addr = name ? dfs_rom_addr(name) : 0;
+	if(rom_addr == 0) {
+		return false;
+	}
+	//Read header to find index size
+	uso_bundle_header_t *bundle = memalign(USO_BUNDLE_DATA_ALIGN, sizeof(uso_bundle_header_t));
+	if(!bundle) {
+		debugf("Failed to allocate header of USO bundle %s.\n", bundle_filename);
+		return false;
+	}
+	read_rom(bundle, rom_addr, sizeof(uso_bundle_header_t));
+	//Index must at least hold the header it is described by
+	if(bundle->magic != USO_BUNDLE_MAGIC || bundle->index_size < sizeof(uso_bundle_header_t)) {
+		debugf("Invalid USO bundle %s.\n", bundle_filename);
+		free(bundle);
+		return false;
+	}
+	//Read whole index in one pass
+	uint32_t index_size = bundle->index_size;
+	free(bundle);
+	bundle = memalign(USO_BUNDLE_DATA_ALIGN, index_size);
+	if(!bundle) {
+		debugf("Failed to allocate %u byte index of USO bundle %s.\n", (unsigned int)index_size, bundle_filename);
+		return false;
+	}
+	read_rom(bundle, rom_addr, index_size);
+	//Replace previous bundle
+	free(__uso_bundle);
+	__uso_bundle = bundle;
+	__uso_bundle_rom_addr = rom_addr;
+	return true;
+}
+
 uso_handle_t *uso_get_handle(const char *filename)
 {
 	//Iterate over USOs
@@ -530,46 +1151,129 @@ uso_handle_t *uso_open(const char *filename)
 		handle->ref_count++;
 		return handle;
 	}
-	//Try to open USO
-	FILE *file = fopen(filename, "rb");
-	if(!file) {
-		//Output open error
-		debugf("Failed to open USO %s.\n", filename);
-		return NULL;
+	//Reopen USO kept in memory after being closed
+	handle = find_cached_uso(filename);
+	if(handle) {
+		if(is_uso_link_current(handle->uso)) {
+			reopen_cached_uso(handle);
+			return handle;
+		}
+		//Load USO again to bind imports the same way a fresh load would
+		evict_cached_uso(handle);
+	}
+	//USOs in bundle are found and read without going through filesystem
+	uso_bundle_entry_t *bundle_entry = find_bundle_entry(filename);
+	FILE *file = NULL;
+	uso_load_info_t load_info;
+	uint32_t uso_align;
+	if(bundle_entry) {
+		load_info = bundle_entry->load_info;
+		//Keep buffer aligned for DMA
+		uso_align = get_uso_ram_align(&load_info);
+		if(uso_align < USO_BUNDLE_DATA_ALIGN) {
+			uso_align = USO_BUNDLE_DATA_ALIGN;
+		}
+	} else {
+		//Try to open USO
+		file = fopen(filename, "rb");
+		if(!file) {
+			//Output open error
+			debugf("Failed to open USO %s.\n", filename);
+			return NULL;
+		}
+		//Read USO load info
+		fseek(file, -sizeof(uso_load_info_t), SEEK_END);
+		fread(&load_info, sizeof(uso_load_info_t), 1, file);
+		uso_align = get_uso_ram_align(&load_info);
 	}
 	//Allocate new handle and copy name
 	handle = malloc(sizeof(struct uso_handle_data)+strlen(filename)+1);
 	strcpy(handle->name, filename);
-	//Read USO load info
-	uso_load_info_t load_info;
-	fseek(file, -sizeof(uso_load_info_t), SEEK_END);
-	fread(&load_info, sizeof(uso_load_info_t), 1, file);
+	handle->data_snapshot = NULL;
+	handle->data_snapshot_size = 0;
+	handle->file_sections = NULL;
+	handle->unwind_data = NULL;
+	handle->unwind_rom_addr = 0;
 	//Allocate USO
 	uint32_t uso_size = get_uso_ram_size(&load_info);
-	handle->uso = memalign(get_uso_ram_align(&load_info), uso_size);
+	handle->uso = alloc_uso_memory(uso_align, uso_size, true);
+	if(!handle->uso) {
+		debugf("Not enough memory to load USO %s.\n", filename);
+		if(file) {
+			fclose(file);
+		}
+		free(handle);
+		return NULL;
+	}
+	handle->ram_size = uso_size;
+	handle->noload_ofs = get_uso_noload_start_ofs(&load_info);
 	//Erase USO
 	memset(handle->uso, 0, uso_size);
 	//Read USO file
-	fseek(file, 0, SEEK_SET);
-	fread(handle->uso, load_info.uso_size, 1, file);
-	fclose(file);
+	if(bundle_entry) {
+		read_rom(handle->uso, get_uso_rom_addr(filename, bundle_entry), load_info.uso_size);
+	} else {
+		fseek(file, 0, SEEK_SET);
+		fread(handle->uso, load_info.uso_size, 1, file);
+	}
+	uso_header_t *uso = handle->uso;
+	if(uso->unwind_size != 0) {
+		//Unwind sections left in ROM are placed using section table from file
+		handle->file_sections = malloc(uso->num_sections*sizeof(uso_section_t));
+		memcpy(handle->file_sections, (uint8_t *)uso+(uintptr_t)uso->sections, uso->num_sections*sizeof(uso_section_t));
+		handle->unwind_rom_addr = get_uso_rom_addr(filename, bundle_entry);
+		if(handle->unwind_rom_addr != 0) {
+			handle->unwind_rom_addr += uso->unwind_ofs;
+		} else {
+			//Unwind sections of USOs outside ROM are read now and kept
+			handle->unwind_data = alloc_uso_memory(USO_UNWIND_ALIGN, uso->unwind_size, true);
+			if(handle->unwind_data) {
+				fseek(file, uso->unwind_ofs, SEEK_SET);
+				fread(handle->unwind_data, uso->unwind_size, 1, file);
+			}
+		}
+	}
+	if(file) {
+		fclose(file);
+	}
+	if(uso->unwind_size != 0 && handle->unwind_rom_addr == 0 && !handle->unwind_data) {
+		debugf("Not enough memory to load USO %s.\n", filename);
+		free_uso(handle);
+		return NULL;
+	}
+	//Reject USOs bound at build time to a different global symbol table
+	if(uso->global_fingerprint && uso->global_fingerprint != __uso_global_table->fingerprint) {
+		debugf("USO %s was built for a different global symbol table.\n", filename);
+		free_uso(handle);
+		return NULL;
+	}
 	//Do loading work to USO
-	if(!fixup_uso(handle->uso, get_uso_noload_start(&load_info, handle->uso))) {
+	if(!fixup_uso(uso, get_uso_noload_start(&load_info, uso))) {
 		//Output load error
 		debugf("Failed to load USO %s.\n", filename);
 		//Get rid of USO if it failed to load
-		free(handle->uso);
-		free(handle);
+		free_uso(handle);
 		return NULL;
 	}
+	if(handle->unwind_data) {
+		link_unwind_data(handle, handle->unwind_data);
+	}
+	//Keep linked data for reopening USO after it is closed
+	handle->cacheable = false;
+	if(__uso_cache_budget != 0) {
+		snapshot_uso_data(handle);
+	}
 	//Invalidate cache of USO to make sure new code/data is seen
 	flush_uso(handle->uso);
 	//Add handle to USO list
 	handle->ref_count = 1;
-	insert_uso(handle);
+	insert_uso(&__uso_list_head, &__uso_list_tail, handle);
 	if(__uso_notify_add_func) {
 		__uso_notify_add_func();
 	}
+	if(__uso_profile_update_func) {
+		__uso_profile_update_func();
+	}
 	start_uso(handle->uso, handle->frameobj_data);
 	return handle;
 }
@@ -597,11 +1301,35 @@ void uso_close(uso_handle_t *handle)
 	if(is_uso_closeable(handle) && handle->ref_count == 0) {
 		end_uso(handle->uso);
 		//Do removal work of USO
-		remove_uso(handle);
+		remove_uso(&__uso_list_head, &__uso_list_tail, handle);
 		if(__uso_notify_remove_func) {
 			__uso_notify_remove_func();
 		}
-		free(handle->uso);
-		free(handle);
+		if(__uso_profile_update_func) {
+			__uso_profile_update_func();
+		}
+		evict_bound_usos(handle);
+		//Unwind data is read from ROM again if USO is reopened
+		if(handle->unwind_data && handle->unwind_rom_addr != 0) {
+			drop_unwind_data(handle);
+		}
+		//Keep USO linked in memory if it fits in cache
+		if(!cache_uso(handle)) {
+			free_uso(handle);
+		}
+	}
+}
+
+void uso_set_cache_budget(size_t budget)
+{
+	__uso_cache_budget = budget;
+	//Evict least recently closed USOs until cache fits in new budget
+	while(__uso_cache_size > budget) {
+		evict_cached_uso(__uso_cache_head);
 	}
-}
\ No newline at end of file
+}
+
+void uso_free_unwind_data(void)
+{
+	while(drop_unused_unwind_data());
+}
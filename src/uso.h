@@ -11,6 +11,10 @@ typedef struct uso_handle_data uso_handle_t;
 
 //Initializes USO library and load global symbol file
 void uso_init(const char *global_sym_filename);
+//Open USOs through index of bundle made by make_uso_bundle instead of filesystem
+//USOs missing from bundle are still opened from filesystem
+//Returns false if bundle can't be read
+bool uso_init_bundle(const char *bundle_filename);
 //Get handle to existing USO by filename
 //Does not increment reference count
 uso_handle_t *uso_get_handle(const char *filename);
@@ -30,6 +34,12 @@ void *uso_sym(uso_handle_t *handle, const char *name);
 //Close USO handle
 //The USO will be unloaded when the reference count reaches zero and it is not being used by another loaded USO
 void uso_close(uso_handle_t *handle);
+//Set maximum bytes of closed USOs kept linked in memory so reopening them skips loading
+//Only USOs opened while the budget is non-zero can be kept and the default budget is zero
+void uso_set_cache_budget(size_t budget);
+//Free unwind sections read from ROM of every loaded USO
+//They are read again the next time an exception passes through each USO
+void uso_free_unwind_data(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,48 @@
+#ifndef USO_FORMAT_H
+#define USO_FORMAT_H
+
+//Layout of USO and global symbol files shared by the runtime and the host tools
+//Both sides check their structures against these sizes
+
+//Size of each file structure in bytes
+#define USO_HEADER_SIZE 44
+#define USO_SECTION_SIZE 20
+#define USO_SYMBOL_SIZE 12
+#define USO_SYMBOL_TABLE_SIZE 4 //Count before symbols
+#define USO_RELOC_SIZE 12
+#define USO_RELOC_TABLE_SIZE 4 //Count before relocations
+#define USO_GLOBAL_TABLE_SIZE 40
+#define USO_LOAD_INFO_SIZE 16
+#define USO_BUNDLE_HEADER_SIZE 24
+#define USO_BUNDLE_ENTRY_SIZE 28
+#define USO_EH_FRAME_HDR_SIZE 12 //Count before search table entries
+#define USO_EH_FRAME_HDR_ENTRY_SIZE 8
+
+//Number of front-coded names between full names in global symbol table
+#define USO_GLOBAL_RESTART_INTERVAL 16
+
+//Top bit of section data_align is set when section is writable
+#define USO_SECTION_WRITABLE 0x80000000
+//Next bit is set for exception unwind sections left out of the loaded USO image
+#define USO_SECTION_UNWIND 0x40000000
+#define USO_SECTION_ALIGN_MASK 0x3FFFFFFF
+
+//Unwind sections left in ROM start at a multiple of this in the file for PI DMA into cache lines
+#define USO_UNWIND_ALIGN 16
+
+//USO bundle identifier 'USOB'
+#define USO_BUNDLE_MAGIC 0x55534F42
+//Bundle index and each USO image in a bundle start at a multiple of this for PI DMA into cache lines
+#define USO_BUNDLE_DATA_ALIGN 16
+
+//FDE search table uses the .eh_frame_hdr layout with entries relative to table start
+#define USO_EH_FRAME_HDR_VERSION 1
+#define USO_EH_FRAME_HDR_PTR_ENC 0x1B //DW_EH_PE_pcrel | DW_EH_PE_sdata4
+#define USO_EH_FRAME_HDR_COUNT_ENC 0x03 //DW_EH_PE_udata4
+#define USO_EH_FRAME_HDR_TABLE_ENC 0x3B //DW_EH_PE_datarel | DW_EH_PE_sdata4
+
+//Top bit of symbol name_len is set when symbol is weak
+#define USO_SYMBOL_WEAK 0x8000
+#define USO_SYMBOL_NAME_LEN_MASK 0x7FFF
+
+#endif
@@ -3,21 +3,25 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "uso_format.h"
 
 //USO relocation types
 #define R_MIPS_32 2
 #define R_MIPS_26 4
 #define R_MIPS_HI16 5
 #define R_MIPS_LO16 6
+#define R_MIPS_GPREL16 7
 
+//Import symbols bound by ordinal have an empty name, a section of the provider module ID,
+//and a ptr of the index into the provider export symbol table before being resolved
 typedef struct uso_symbol {
-    const char *name; //Relative to symbol table
+    uint32_t name_ofs; //Relative to symbol table, never fixed up
     void *ptr;
     uint16_t section;
     uint16_t name_len; //Top bit used to tell if symbol is weak
 } uso_symbol_t;
 
-_Static_assert(sizeof(uso_symbol_t) == 12, "Invalid uso_symbol_t size.");
+_Static_assert(sizeof(uso_symbol_t) == USO_SYMBOL_SIZE, "Invalid uso_symbol_t size.");
 
 //Symbols should appear sorted by name in ASCII order
 typedef struct uso_symbol_table {
@@ -25,7 +29,26 @@ typedef struct uso_symbol_table {
 	uso_symbol_t data[0]; //Real size is num_symbols
 } uso_symbol_table_t;
 
-_Static_assert(sizeof(uso_symbol_table_t) == 4, "Invalid uso_symbol_table_t size.");
+_Static_assert(sizeof(uso_symbol_table_t) == USO_SYMBOL_TABLE_SIZE, "Invalid uso_symbol_table_t size.");
+
+//Global symbol file contents
+//Minimal perfect hash maps symbol names to an index in name order
+//Each name is stored as a shared prefix length and suffix length (both LEB128) followed by the suffix
+//The first name of each restart block has no shared prefix
+typedef struct uso_global_table {
+	uint32_t num_syms;
+	uint32_t hash_seed;
+	uint32_t num_buckets;
+	uint32_t buckets_ofs; //Relative to global table, displacement per hash bucket
+	uint32_t slots_ofs; //Relative to global table, symbol index per hash slot
+	uint32_t addrs_ofs; //Relative to global table, address per symbol sorted by name
+	uint32_t restarts_ofs; //Relative to global table, name offset per restart block
+	uint32_t names_ofs; //Relative to global table, front-coded names sorted by name
+	uint32_t fingerprint; //Hash of symbol names and addresses
+	uint32_t gp; //Value of _gp in main binary, zero if missing
+} uso_global_table_t;
+
+_Static_assert(sizeof(uso_global_table_t) == USO_GLOBAL_TABLE_SIZE, "Invalid uso_global_table_t size.");
 
 typedef struct uso_reloc {
     uint32_t offset;
@@ -33,14 +56,14 @@ typedef struct uso_reloc {
     uint32_t sym_offset; //Section-relative symbol offset, zero for external relocations
 } uso_reloc_t;
 
-_Static_assert(sizeof(uso_reloc_t) == 12, "Invalid uso_reloc_t size.");
+_Static_assert(sizeof(uso_reloc_t) == USO_RELOC_SIZE, "Invalid uso_reloc_t size.");
 
 typedef struct uso_reloc_table {
 	uint32_t length;
 	uso_reloc_t data[0]; //Real size is length
 } uso_reloc_table_t;
 
-_Static_assert(sizeof(uso_reloc_table_t) == 4, "Invalid uso_reloc_table_t size.");
+_Static_assert(sizeof(uso_reloc_table_t) == USO_RELOC_TABLE_SIZE, "Invalid uso_reloc_table_t size.");
 
 //Section 0 is treated as dummy section
 //Every SHF_ALLOC section is included in file
@@ -53,7 +76,7 @@ typedef struct uso_section {
     uso_reloc_table_t *external_relocs;
 } uso_section_t;
 
-_Static_assert(sizeof(uso_section_t) == 20, "Invalid uso_section_t size.");
+_Static_assert(sizeof(uso_section_t) == USO_SECTION_SIZE, "Invalid uso_section_t size.");
 
 typedef struct uso_header {
 	uint16_t num_sections;
@@ -63,10 +86,17 @@ typedef struct uso_header {
     uso_symbol_table_t *export_syms;
     uint16_t ctors_section;
     uint16_t dtors_section;
+    uint32_t global_fingerprint; //Zero if no imports are bound at build time
+    uint32_t module_set_fingerprint; //Zero if not part of a module set
+    uso_symbol_table_t *import_debug_syms; //Names of imports bound by ordinal, may be NULL
+    uint16_t module_id; //Zero if not part of a module set
+    uint16_t eh_frame_hdr_section; //Zero if exception frames are registered with libgcc
+    uint32_t unwind_ofs; //File offset of unwind sections left in ROM, zero if every section is loaded
+    uint32_t unwind_size;
 	char src_elf_name[0]; //Treated as const char * string
 } uso_header_t;
 
-_Static_assert(sizeof(uso_header_t) == 20, "Invalid uso_header_t size.");
+_Static_assert(sizeof(uso_header_t) == USO_HEADER_SIZE, "Invalid uso_header_t size.");
 
 typedef struct uso_load_info {
     uint32_t uso_size;
@@ -75,7 +105,51 @@ typedef struct uso_load_info {
     uint32_t noload_align;
 } uso_load_info_t;
 
-_Static_assert(sizeof(uso_load_info_t) == 16, "Invalid uso_load_info_t size.");
+_Static_assert(sizeof(uso_load_info_t) == USO_LOAD_INFO_SIZE, "Invalid uso_load_info_t size.");
+
+//FDE search table in .eh_frame_hdr layout
+//Offsets only need fixing up when unwind sections are read apart from the rest of the USO
+typedef struct uso_eh_frame_hdr_entry {
+	int32_t func_ofs; //Relative to table start
+	int32_t fde_ofs; //Relative to table start
+} uso_eh_frame_hdr_entry_t;
+
+_Static_assert(sizeof(uso_eh_frame_hdr_entry_t) == USO_EH_FRAME_HDR_ENTRY_SIZE, "Invalid uso_eh_frame_hdr_entry_t size.");
+
+typedef struct uso_eh_frame_hdr {
+	uint8_t version;
+	uint8_t eh_frame_ptr_enc;
+	uint8_t fde_count_enc;
+	uint8_t table_enc;
+	int32_t eh_frame_ofs; //Relative to this field
+	uint32_t num_entries;
+	uso_eh_frame_hdr_entry_t entries[0]; //Sorted by func_ofs
+} uso_eh_frame_hdr_t;
+
+_Static_assert(sizeof(uso_eh_frame_hdr_t) == USO_EH_FRAME_HDR_SIZE, "Invalid uso_eh_frame_hdr_t size.");
+
+//USO bundle contents
+//Index is at start of bundle and is read into memory in one piece
+//Entries are grouped by bucket of name hash while USO images are laid out in load order
+typedef struct uso_bundle_entry {
+	uint32_t name_hash; //FNV-1a hash of name
+	uint32_t name_ofs; //Relative to bundle, path relative to filesystem root
+	uint32_t data_ofs; //Relative to bundle
+	uso_load_info_t load_info; //Copy of load info at end of USO image
+} uso_bundle_entry_t;
+
+_Static_assert(sizeof(uso_bundle_entry_t) == USO_BUNDLE_ENTRY_SIZE, "Invalid uso_bundle_entry_t size.");
+
+typedef struct uso_bundle_header {
+	uint32_t magic;
+	uint32_t num_entries;
+	uint32_t num_buckets; //Power of 2
+	uint32_t buckets_ofs; //Relative to bundle, first entry of each bucket followed by num_entries
+	uint32_t entries_ofs; //Relative to bundle
+	uint32_t index_size; //Size of header, buckets, entries, and names
+} uso_bundle_header_t;
+
+_Static_assert(sizeof(uso_bundle_header_t) == USO_BUNDLE_HEADER_SIZE, "Invalid uso_bundle_header_t size.");
 
 struct uso_handle_data {
 	struct uso_handle_data *next;
@@ -83,23 +157,41 @@ struct uso_handle_data {
 	uso_header_t *uso;
 	size_t ref_count;
 	uint32_t frameobj_data[6];
+	uint32_t ram_size; //Size of USO including noload sections
+	uint32_t noload_ofs; //Offset of noload sections from USO
+	bool cacheable; //USO can be kept loaded after closing
+	void *data_snapshot; //Writable section data right after linking
+	uint32_t data_snapshot_size;
+	uso_section_t *file_sections; //Section table as read from file, NULL if every section is loaded with USO
+	void *unwind_data; //Unwind sections left in ROM, NULL until first exception passes through USO
+	uint32_t unwind_rom_addr; //Zero if unwind sections are read with USO and never dropped
 	char name[0];
 };
 
 //External global variables
-extern uso_symbol_table_t *__uso_global_symbol_table;
+extern uso_global_table_t *__uso_global_table;
+//USO bundle variables, bundle is NULL if none is used
+extern uso_bundle_header_t *__uso_bundle;
+extern uint32_t __uso_bundle_rom_addr;
 //USO List variables
 extern struct uso_handle_data *__uso_list_head;
 extern struct uso_handle_data *__uso_list_tail;
+//Closed USO cache variables, least recently closed USO is at head
+extern struct uso_handle_data *__uso_cache_head;
+extern struct uso_handle_data *__uso_cache_tail;
+extern size_t __uso_cache_size;
+extern size_t __uso_cache_budget;
 //USO Debugger Notify Function Pointers
 extern void (*__uso_notify_add_func)();
 extern void (*__uso_notify_remove_func)();
+//Called after USO list changes while profiling
+extern void (*__uso_profile_update_func)();
 extern bool __uso_initted;
 
 //USO inline functions
 static inline bool __uso_is_symbol_weak(uso_symbol_t *symbol)
 {
-	if(symbol->name_len & 0x8000) {
+	if(symbol->name_len & USO_SYMBOL_WEAK) {
 		return true;
 	}
 	return false;
@@ -107,7 +199,13 @@ static inline bool __uso_is_symbol_weak(uso_symbol_t *symbol)
 
 static inline uint16_t __uso_symbol_get_name_length(uso_symbol_t *symbol)
 {
-	return symbol->name_len & 0x7FFF;
+	return symbol->name_len & USO_SYMBOL_NAME_LEN_MASK;
+}
+
+static inline const char *__uso_symbol_get_name(uso_symbol_table_t *table, uso_symbol_t *symbol)
+{
+	//Names are stored relative to start of symbol table
+	return (const char *)table+symbol->name_ofs;
 }
 
 static inline uint8_t __uso_get_reloc_type(uso_reloc_t *reloc)
@@ -0,0 +1,209 @@
+#include <libdragon.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uso_profile.h"
+#include "uso_internal.h"
+
+//Samples store section offsets instead of PCs so USOs can be symbolized wherever they were loaded
+
+//Module of samples outside every USO, these store PC instead of an offset
+#define MAIN_MODULE 0xFFFF
+
+typedef struct profile_range {
+	uint32_t start;
+	uint32_t end;
+	uint16_t module; //Index into profiled modules
+	uint16_t section;
+} profile_range_t;
+
+typedef struct profile_index {
+	uint32_t num_ranges;
+	profile_range_t ranges[0]; //Sorted by start, never overlapping
+} profile_index_t;
+
+typedef struct profile_sample {
+	uint16_t module;
+	uint16_t section;
+	uint32_t offset;
+} profile_sample_t;
+
+typedef struct profile_module {
+	char *name;
+	char *src_elf_name;
+} profile_module_t;
+
+//Index is replaced with a single pointer store so the timer interrupt only ever sees a whole index
+static profile_index_t *volatile profile_index;
+static profile_module_t *profile_modules;
+static uint32_t profile_num_modules;
+static profile_sample_t *profile_samples;
+static volatile uint32_t profile_num_samples;
+static uint32_t profile_max_samples;
+static timer_link_t *profile_timer;
+
+static uint16_t get_profile_module(struct uso_handle_data *handle)
+{
+	//Samples of a USO reopened at another address still count towards the same module
+	for(uint32_t i=0; i<profile_num_modules; i++) {
+		if(strcmp(profile_modules[i].name, handle->name) == 0) {
+			return i;
+		}
+	}
+	profile_modules = realloc(profile_modules, (profile_num_modules+1)*sizeof(profile_module_t));
+	profile_modules[profile_num_modules].name = strdup(handle->name);
+	profile_modules[profile_num_modules].src_elf_name = strdup(handle->uso->src_elf_name);
+	return profile_num_modules++;
+}
+
+static int compare_ranges(const void *a, const void *b)
+{
+	const profile_range_t *range_a = a;
+	const profile_range_t *range_b = b;
+	if(range_a->start != range_b->start) {
+		return range_a->start < range_b->start ? -1 : 1;
+	}
+	return 0;
+}
+
+static void update_profile_index()
+{
+	//Count sections of loaded USOs
+	uint32_t num_ranges = 0;
+	struct uso_handle_data *curr = __uso_list_head;
+	while(curr) {
+		for(uint16_t i=0; i<curr->uso->num_sections; i++) {
+			if(curr->uso->sections[i].data && curr->uso->sections[i].data_size != 0) {
+				num_ranges++;
+			}
+		}
+		curr = curr->next;
+	}
+	//Build new index
+	profile_index_t *index = malloc(sizeof(profile_index_t)+(num_ranges*sizeof(profile_range_t)));
+	assertf(index, "Failed to allocate USO profile index.\n");
+	index->num_ranges = 0;
+	curr = __uso_list_head;
+	while(curr) {
+		uint16_t module = get_profile_module(curr);
+		for(uint16_t i=0; i<curr->uso->num_sections; i++) {
+			uso_section_t *section = &curr->uso->sections[i];
+			if(section->data && section->data_size != 0) {
+				profile_range_t *range = &index->ranges[index->num_ranges++];
+				range->start = (uint32_t)section->data;
+				range->end = range->start+section->data_size;
+				range->module = module;
+				range->section = i;
+			}
+		}
+		curr = curr->next;
+	}
+	qsort(index->ranges, index->num_ranges, sizeof(profile_range_t), compare_ranges);
+	//Interrupts run to completion before main code resumes so the old index is unused once replaced
+	profile_index_t *old_index = profile_index;
+	profile_index = index;
+	free(old_index);
+}
+
+static void sample_pc(int ovfl)
+{
+	uint32_t num_samples = profile_num_samples;
+	if(num_samples >= profile_max_samples) {
+		return;
+	}
+	//Nothing in the timer interrupt raises an exception so EPC still holds interrupted PC
+	uint32_t pc = C0_READ_EPC();
+	profile_sample_t *sample = &profile_samples[num_samples];
+	sample->module = MAIN_MODULE;
+	sample->section = 0;
+	sample->offset = pc;
+	//Binary search for last range starting at or before PC
+	profile_index_t *index = profile_index;
+	uint32_t min = 0;
+	uint32_t max = index->num_ranges;
+	while(min < max) {
+		uint32_t mid = (min+max)/2;
+		if(index->ranges[mid].start <= pc) {
+			min = mid+1;
+		} else {
+			max = mid;
+		}
+	}
+	if(min != 0 && pc < index->ranges[min-1].end) {
+		sample->module = index->ranges[min-1].module;
+		sample->section = index->ranges[min-1].section;
+		sample->offset = pc-index->ranges[min-1].start;
+	}
+	profile_num_samples = num_samples+1;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+	const profile_sample_t *sample_a = a;
+	const profile_sample_t *sample_b = b;
+	if(sample_a->module != sample_b->module) {
+		return sample_a->module < sample_b->module ? -1 : 1;
+	}
+	if(sample_a->section != sample_b->section) {
+		return sample_a->section < sample_b->section ? -1 : 1;
+	}
+	if(sample_a->offset != sample_b->offset) {
+		return sample_a->offset < sample_b->offset ? -1 : 1;
+	}
+	return 0;
+}
+
+void uso_profile_start(uint32_t frequency, uint32_t max_samples)
+{
+	assertf(__uso_initted, "Call uso_init before profiling USOs.\n");
+	assertf(frequency != 0, "USO profile frequency must be non-zero.\n");
+	uso_profile_stop();
+	//Samples buffer is allocated up front as the interrupt can't allocate
+	free(profile_samples);
+	profile_samples = malloc(max_samples*sizeof(profile_sample_t));
+	assertf(profile_samples || max_samples == 0, "Failed to allocate %u USO profile samples.\n", (unsigned int)max_samples);
+	profile_max_samples = max_samples;
+	profile_num_samples = 0;
+	//Index must exist before first sample
+	update_profile_index();
+	__uso_profile_update_func = update_profile_index;
+	profile_timer = new_timer(TICKS_PER_SECOND/frequency, TF_CONTINUOUS, sample_pc);
+}
+
+void uso_profile_stop(void)
+{
+	if(profile_timer) {
+		delete_timer(profile_timer);
+		profile_timer = NULL;
+	}
+	//Index is no longer needed until profiling starts again
+	__uso_profile_update_func = NULL;
+	free(profile_index);
+	profile_index = NULL;
+}
+
+void uso_profile_dump(void)
+{
+	uso_profile_stop();
+	//Sort samples so each PC is printed once with its count
+	uint32_t num_samples = profile_num_samples;
+	qsort(profile_samples, num_samples, sizeof(profile_sample_t), compare_samples);
+	debugf("USOPROF BEGIN %u\n", (unsigned int)num_samples);
+	for(uint32_t i=0; i<profile_num_modules; i++) {
+		debugf("USOPROF MODULE %u %s %s\n", (unsigned int)i, profile_modules[i].name, profile_modules[i].src_elf_name);
+	}
+	uint32_t i = 0;
+	while(i < num_samples) {
+		profile_sample_t *sample = &profile_samples[i];
+		uint32_t count = 1;
+		while(i+count < num_samples && compare_samples(sample, &profile_samples[i+count]) == 0) {
+			count++;
+		}
+		if(sample->module == MAIN_MODULE) {
+			debugf("USOPROF MAIN %08x %u\n", (unsigned int)sample->offset, (unsigned int)count);
+		} else {
+			debugf("USOPROF SAMPLE %u %u %x %u\n", sample->module, sample->section, (unsigned int)sample->offset, (unsigned int)count);
+		}
+		i += count;
+	}
+	debugf("USOPROF END\n");
+}
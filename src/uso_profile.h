@@ -0,0 +1,27 @@
+#ifndef USO_PROFILE_H
+#define USO_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Sampling profiler that records PCs inside USOs by module and section offset
+//Dumps are symbolized on the host with uso_symbolize
+//Only available with dynamically loaded USOs
+
+//Start sampling PC frequency times per second until max_samples are taken
+//Restarts profiling with no samples if already profiling
+//Requires timer_init to be called first
+void uso_profile_start(uint32_t frequency, uint32_t max_samples);
+//Stop sampling PC while keeping samples
+void uso_profile_stop(void);
+//Print samples taken since profiling started to debug output
+void uso_profile_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,221 @@
+#include <libdragon.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uso.h"
+#include "uso_static_internal.h"
+
+//Replacement for uso.c when every module is linked into the main binary
+//Opening a module only runs its constructors and _prolog as nothing needs to be loaded or relocated
+
+typedef void (*func_ptr)(); //Generic function pointer
+
+extern void __cxa_finalize(void *dso);
+
+struct uso_handle_data {
+	const uso_static_module_t *module;
+	size_t ref_count; //Module is open when non-zero
+};
+
+static struct uso_handle_data *handles;
+static bool initted;
+
+static bool is_module_name(const char *filename, const char *name)
+{
+	size_t filename_len = strlen(filename);
+	size_t name_len = strlen(name);
+	if(filename_len < name_len || strcmp(filename+filename_len-name_len, name) != 0) {
+		return false;
+	}
+	//Module name must be whole filename or come after a directory separator
+	return filename_len == name_len || filename[filename_len-name_len-1] == '/';
+}
+
+static struct uso_handle_data *find_handle(const char *filename)
+{
+	for(uint32_t i=0; i<__uso_static_num_modules; i++) {
+		if(is_module_name(filename, __uso_static_modules[i].name)) {
+			return &handles[i];
+		}
+	}
+	return NULL;
+}
+
+static void *search_symbol_table(const uso_static_module_t *module, const char *name)
+{
+	uint32_t min = 0;
+	uint32_t max = module->num_export_syms;
+	//Binary search for symbol
+	while(min < max) {
+		uint32_t mid = (min+max)/2;
+		int result = strcmp(name, module->export_syms[mid].name);
+		if(result == 0) {
+			return module->export_syms[mid].ptr;
+		} else if(result > 0) {
+			min = mid+1;
+		} else {
+			max = mid;
+		}
+	}
+	return NULL;
+}
+
+static void run_ctors(const uso_static_module_t *module)
+{
+	func_ptr *ctor_start = module->ctors_start;
+	//Check if any constructors exist
+	if(ctor_start && module->ctors_end > ctor_start) {
+		//Run constructors in reverse order like the dynamic loader
+		func_ptr *ctor_curr = module->ctors_end-1;
+		while(ctor_curr >= ctor_start) {
+			(*ctor_curr)();
+			ctor_curr--;
+		}
+	}
+}
+
+static void run_dtors(const uso_static_module_t *module)
+{
+	//Run atexit destructors registered with module dso handle before running dtors
+	__cxa_finalize(module->dso_handle);
+	func_ptr *dtor_curr = module->dtors_start;
+	//Check if any destructors exist
+	if(dtor_curr) {
+		//Run destructors in stored order
+		while(dtor_curr < module->dtors_end) {
+			(*dtor_curr)();
+			dtor_curr++;
+		}
+	}
+}
+
+static void start_uso(const uso_static_module_t *module)
+{
+	//Exception frames are registered with the main binary
+	run_ctors(module);
+	//Run _prolog after constructors if it exists
+	if(module->prolog) {
+		module->prolog();
+	}
+}
+
+static void end_uso(const uso_static_module_t *module)
+{
+	//Run epilog function before anything else
+	if(module->epilog) {
+		module->epilog();
+	}
+	run_dtors(module);
+}
+
+void uso_init(const char *global_sym_filename)
+{
+	//Global symbols are resolved when linking so global symbol file is not read
+	handles = calloc(__uso_static_num_modules, sizeof(struct uso_handle_data));
+	for(uint32_t i=0; i<__uso_static_num_modules; i++) {
+		handles[i].module = &__uso_static_modules[i];
+	}
+	initted = true;
+}
+
+bool uso_init_bundle(const char *bundle_filename)
+{
+	//Modules are linked into the main binary so there is no bundle to read
+	return false;
+}
+
+uso_handle_t *uso_get_handle(const char *filename)
+{
+	struct uso_handle_data *handle = find_handle(filename);
+	//Only open modules have handles
+	if(handle && handle->ref_count != 0) {
+		return handle;
+	}
+	return NULL;
+}
+
+uso_handle_t *uso_get_handle_ptr(void *ptr)
+{
+	//Search section bounds of every open module
+	for(uint32_t i=0; i<__uso_static_num_modules; i++) {
+		if(handles[i].ref_count == 0) {
+			continue;
+		}
+		const uso_static_module_t *module = handles[i].module;
+		for(uint32_t j=0; j<USO_STATIC_NUM_RANGES; j++) {
+			const uso_static_range_t *range = &module->ranges[j];
+			if(range->start && ptr >= range->start && ptr < range->end) {
+				return &handles[i];
+			}
+		}
+	}
+	return NULL;
+}
+
+bool uso_is_handle_valid(uso_handle_t *handle)
+{
+	//Handle must be for an open module
+	if(!initted || handle < handles || handle >= handles+__uso_static_num_modules) {
+		return false;
+	}
+	return handle->ref_count != 0;
+}
+
+uso_handle_t *uso_open(const char *filename)
+{
+	//Check if uso_init has been called
+	assertf(initted, "Call uso_init before opening any USOs.\n");
+	uso_handle_t *handle = find_handle(filename);
+	if(!handle) {
+		//Output open error
+		debugf("Failed to open USO %s.\n", filename);
+		return NULL;
+	}
+	//Increment reference count if module is already open
+	if(handle->ref_count != 0) {
+		handle->ref_count++;
+		return handle;
+	}
+	handle->ref_count = 1;
+	start_uso(handle->module);
+	return handle;
+}
+
+void *uso_sym(uso_handle_t *handle, const char *name)
+{
+	if(handle == USO_HANDLE_ANY) {
+		//Search through all open modules if special handle is passed
+		for(uint32_t i=0; i<__uso_static_num_modules; i++) {
+			if(handles[i].ref_count != 0) {
+				void *ptr = search_symbol_table(handles[i].module, name);
+				if(ptr) {
+					return ptr;
+				}
+			}
+		}
+		return NULL;
+	}
+	//Check if passed USO handle is valid
+	assertf(uso_is_handle_valid(handle), "Can't get symbols from invalid USO handle %p.\n", handle);
+	return search_symbol_table(handle->module, name);
+}
+
+void uso_close(uso_handle_t *handle)
+{
+	assertf(uso_is_handle_valid(handle), "Can't close invalid USO handle %p.\n", handle);
+	//Decrement reference count and end module when no references remain
+	handle->ref_count--;
+	if(handle->ref_count == 0) {
+		end_uso(handle->module);
+	}
+}
+
+void uso_set_cache_budget(size_t budget)
+{
+	//Modules always stay in memory so there is nothing to cache
+}
+
+void uso_free_unwind_data(void)
+{
+	//Unwind sections are part of the main binary
+}
@@ -0,0 +1,39 @@
+#ifndef USO_STATIC_INTERNAL_H
+#define USO_STATIC_INTERNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//Modules linked into the main binary are described by a registry generated by make_uso_static
+
+typedef struct uso_static_symbol {
+	const char *name;
+	void *ptr;
+} uso_static_symbol_t;
+
+typedef struct uso_static_range {
+	void *start; //NULL if module has no section of this kind
+	void *end;
+} uso_static_range_t;
+
+//Text, read-only data, data and bss bounds of each module
+#define USO_STATIC_NUM_RANGES 4
+
+typedef struct uso_static_module {
+	const char *name; //USO path relative to filesystem root
+	const uso_static_symbol_t *export_syms; //Sorted by name in ASCII order
+	uint32_t num_export_syms;
+	void (**ctors_start)(); //NULL if module has no constructors
+	void (**ctors_end)();
+	void (**dtors_start)(); //NULL if module has no destructors
+	void (**dtors_end)();
+	void (*prolog)(); //NULL if module has no _prolog
+	void (*epilog)(); //NULL if module has no _epilog
+	void *dso_handle; //Replaces __dso_handle of module
+	uso_static_range_t ranges[USO_STATIC_NUM_RANGES];
+} uso_static_module_t;
+
+extern const uso_static_module_t __uso_static_modules[];
+extern const uint32_t __uso_static_num_modules;
+
+#endif
@@ -5,4 +5,8 @@
 //Name mangling will still be applied if compiling a C++ file and can be disabled with extern "C"
 #define USO_EXPORT_SYMBOL __attribute__ ((visibility ("default")))
 
+//USO_SMALL_DATA places a main binary global in small data so USOs built with USO_GPOPT=1 access it relative to GP
+//It must be on the declaration seen by both the main binary and USOs
+#define USO_SMALL_DATA __attribute__ ((section (".sdata")))
+
 #endif
\ No newline at end of file
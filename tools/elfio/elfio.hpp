@@ -24,6 +24,8 @@ THE SOFTWARE.
 #define ELFIO_HPP
 
 #include <string>
+#include <string_view>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <functional>
@@ -40,6 +42,7 @@ THE SOFTWARE.
 #include <elfio/elfio_section.hpp>
 #include <elfio/elfio_segment.hpp>
 #include <elfio/elfio_strings.hpp>
+#include <elfio/elfio_mapped.hpp>
 
 #define ELFIO_HEADER_ACCESS_GET( TYPE, FNAME )         \
     TYPE get_##FNAME() const noexcept                  \
@@ -88,6 +91,8 @@ class elfio
         convertor       = std::move( other.convertor );
         addr_translator = std::move( other.addr_translator );
         compression     = std::move( other.compression );
+        pstream         = std::move( other.pstream );
+        pmapped         = std::move( other.pmapped );
 
         other.header = nullptr;
         other.sections_.clear();
@@ -105,6 +110,8 @@ class elfio
             addr_translator  = std::move( other.addr_translator );
             current_file_pos = other.current_file_pos;
             compression      = std::move( other.compression );
+            pstream          = std::move( other.pstream );
+            pmapped          = std::move( other.pmapped );
 
             other.current_file_pos = 0;
             other.header           = nullptr;
@@ -150,12 +157,28 @@ class elfio
         bool ret = load( *pstream, is_lazy );
 
         if ( !is_lazy ) {
-            pstream.release();
+            pstream.reset();
         }
 
         return ret;
     }
 
+    //------------------------------------------------------------------------------
+    //! Loads the file lazily from a memory mapping of it.
+    //! Section and segment data is only copied out of the mapping the first
+    //! time it is accessed, so sections a tool never touches are never read.
+    bool load_mapped( const std::string& file_name ) noexcept
+    {
+        pstream.reset();
+        pmapped = std::make_unique<mapped_file>();
+        if ( !pmapped->open( file_name ) ) {
+            pmapped.reset();
+            return false;
+        }
+
+        return load( pmapped->get_stream(), true );
+    }
+
     //------------------------------------------------------------------------------
     bool load( std::istream& stream, bool is_lazy = false ) noexcept
     {
@@ -1093,6 +1116,7 @@ class elfio
     //------------------------------------------------------------------------------
   private:
     std::unique_ptr<std::ifstream>         pstream = nullptr;
+    std::unique_ptr<mapped_file>           pmapped = nullptr;
     std::unique_ptr<elf_header>            header  = nullptr;
     std::vector<std::unique_ptr<section>>  sections_;
     std::vector<std::unique_ptr<segment>>  segments_;
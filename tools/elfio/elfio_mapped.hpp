@@ -0,0 +1,165 @@
+/*
+Copyright (C) 2001-present by Serge Lamikhov-Center
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#ifndef ELFIO_MAPPED_HPP
+#define ELFIO_MAPPED_HPP
+
+#include <cstddef>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ELFIO {
+
+//------------------------------------------------------------------------------
+//! Read only view of a whole file mapped into memory.
+//! Pages are only read from disk once something touches them, so lazily
+//! loaded sections that are never accessed cost neither time nor memory.
+class mapped_file : public std::streambuf
+{
+  public:
+    //------------------------------------------------------------------------------
+    mapped_file() noexcept : stream( this ) {}
+
+    //------------------------------------------------------------------------------
+    mapped_file( const mapped_file& )            = delete;
+    mapped_file& operator=( const mapped_file& ) = delete;
+
+    //------------------------------------------------------------------------------
+    ~mapped_file() noexcept override { close(); }
+
+    //------------------------------------------------------------------------------
+    bool open( const std::string& file_name ) noexcept
+    {
+        close();
+#ifdef _WIN32
+        // No mmap here; fall back to reading the file in one go
+        std::ifstream file( file_name.c_str(),
+                            std::ios::in | std::ios::binary );
+        if ( !file ) {
+            return false;
+        }
+        buffer.assign( std::istreambuf_iterator<char>( file ),
+                       std::istreambuf_iterator<char>() );
+        data = buffer.data();
+        size = buffer.size();
+#else
+        int fd = ::open( file_name.c_str(), O_RDONLY );
+        if ( fd < 0 ) {
+            return false;
+        }
+        struct stat st;
+        if ( fstat( fd, &st ) != 0 ) {
+            ::close( fd );
+            return false;
+        }
+        size = size_t( st.st_size );
+        // Empty files can't be mapped
+        if ( size != 0 ) {
+            void* ptr = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( ptr == MAP_FAILED ) {
+                ::close( fd );
+                size = 0;
+                return false;
+            }
+            data = static_cast<char*>( ptr );
+        }
+        ::close( fd ); // Mapping stays valid after closing file
+#endif
+        setg( data, data, data + size );
+        stream.clear();
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    void close() noexcept
+    {
+#ifdef _WIN32
+        buffer.clear();
+#else
+        if ( data != nullptr ) {
+            munmap( data, size );
+        }
+#endif
+        data = nullptr;
+        size = 0;
+        setg( nullptr, nullptr, nullptr );
+    }
+
+    //------------------------------------------------------------------------------
+    std::istream& get_stream() noexcept { return stream; }
+
+    //------------------------------------------------------------------------------
+  protected:
+    //------------------------------------------------------------------------------
+    pos_type seekoff( off_type                off,
+                      std::ios_base::seekdir  dir,
+                      std::ios_base::openmode which ) override
+    {
+        if ( !( which & std::ios_base::in ) ) {
+            return pos_type( off_type( -1 ) );
+        }
+        off_type pos = off;
+        if ( dir == std::ios_base::cur ) {
+            pos += gptr() - eback();
+        }
+        else if ( dir == std::ios_base::end ) {
+            pos += off_type( size );
+        }
+        if ( pos < 0 || pos > off_type( size ) ) {
+            return pos_type( off_type( -1 ) );
+        }
+        setg( data, data + pos, data + size );
+        return pos_type( pos );
+    }
+
+    //------------------------------------------------------------------------------
+    pos_type seekpos( pos_type pos, std::ios_base::openmode which ) override
+    {
+        return seekoff( off_type( pos ), std::ios_base::beg, which );
+    }
+
+    //------------------------------------------------------------------------------
+  private:
+    char*        data = nullptr;
+    size_t       size = 0;
+    std::istream stream;
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+};
+
+} // namespace ELFIO
+
+#endif // ELFIO_MAPPED_HPP
@@ -59,6 +59,28 @@ template <> struct get_sym_and_type<Elf64_Rela>
     static int get_r_type( Elf_Xword info ) { return ELF64_R_TYPE( info ); }
 };
 
+//------------------------------------------------------------------------------
+//! A whole relocation section decoded into one array per field
+struct relocation_table
+{
+    std::vector<Elf64_Addr> offsets;
+    std::vector<Elf_Word>   symbols;
+    std::vector<unsigned>   types;
+    std::vector<Elf_Sxword> addends;
+
+    //------------------------------------------------------------------------------
+    size_t size() const noexcept { return offsets.size(); }
+
+    //------------------------------------------------------------------------------
+    void resize( size_t num )
+    {
+        offsets.resize( num );
+        symbols.resize( num );
+        types.resize( num );
+        addends.resize( num );
+    }
+};
+
 //------------------------------------------------------------------------------
 template <class S> class relocation_section_accessor_template
 {
@@ -118,6 +140,39 @@ template <class S> class relocation_section_accessor_template
         return true;
     }
 
+    //------------------------------------------------------------------------------
+    //! Decodes every entry in one pass instead of one get_entry call each
+    bool get_entries( relocation_table& table ) const
+    {
+        table.resize( 0 );
+        if ( get_entries_num() == 0 ) {
+            return true;
+        }
+        if ( nullptr == relocation_section->get_data() ) {
+            return false;
+        }
+
+        bool is_rela = SHT_RELA == relocation_section->get_type();
+        if ( elf_file.get_class() == ELFCLASS32 ) {
+            if ( is_rela ) {
+                generic_get_entries<Elf32_Rela>( table );
+            }
+            else {
+                generic_get_entries<Elf32_Rel>( table );
+            }
+        }
+        else {
+            if ( is_rela ) {
+                generic_get_entries<Elf64_Rela>( table );
+            }
+            else {
+                generic_get_entries<Elf64_Rel>( table );
+            }
+        }
+
+        return true;
+    }
+
     //------------------------------------------------------------------------------
     bool get_entry( Elf_Xword    index,
                     Elf64_Addr&  offset,
@@ -317,6 +372,67 @@ template <class S> class relocation_section_accessor_template
         return (Elf_Half)relocation_section->get_link();
     }
 
+    //------------------------------------------------------------------------------
+    template <class T> void generic_get_entries( relocation_table& table ) const
+    {
+        table.resize( get_entries_num() );
+        if ( elf_file.get_convertor().is_converting() ) {
+            generic_get_entries<T, true>( table );
+        }
+        else {
+            generic_get_entries<T, false>( table );
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    template <class T, bool swap>
+    void generic_get_entries( relocation_table& table ) const
+    {
+        const char* data       = relocation_section->get_data();
+        Elf_Xword   entry_size = relocation_section->get_entry_size();
+        // Packed entries get a constant stride so the loop can be vectorized
+        if ( entry_size == sizeof( T ) ) {
+            generic_decode_entries<T, swap>( data, sizeof( T ), table );
+        }
+        else {
+            generic_decode_entries<T, swap>( data, entry_size, table );
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    template <class T, bool swap>
+    static void generic_decode_entries( const char*       data,
+                                        Elf_Xword         entry_size,
+                                        relocation_table& table ) noexcept
+    {
+        Elf_Xword   num     = table.size();
+        Elf64_Addr* offsets = table.offsets.data();
+        Elf_Word*   symbols = table.symbols.data();
+        unsigned*   types   = table.types.data();
+        Elf_Sxword* addends = table.addends.data();
+        for ( Elf_Xword i = 0; i < num; ++i ) {
+            const T* pEntry = reinterpret_cast<const T*>( data + i * entry_size );
+            Elf_Xword info  = bulk_convert<swap>( pEntry->r_info );
+            offsets[i]      = bulk_convert<swap>( pEntry->r_offset );
+            symbols[i]      = get_sym_and_type<T>::get_r_sym( info );
+            types[i]        = get_sym_and_type<T>::get_r_type( info );
+            addends[i]      = generic_get_addend<T, swap>( *pEntry );
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    template <class T, bool swap>
+    static Elf_Sxword generic_get_addend( const T& entry ) noexcept
+    {
+        if constexpr ( std::is_same_v<T, Elf32_Rela> ||
+                       std::is_same_v<T, Elf64_Rela> ) {
+            return bulk_convert<swap>( entry.r_addend );
+        }
+        else {
+            return 0;
+        }
+    }
+
     //------------------------------------------------------------------------------
     template <class T>
     void generic_get_entry_rel( Elf_Xword   index,
@@ -25,6 +25,35 @@ THE SOFTWARE.
 
 namespace ELFIO {
 
+//------------------------------------------------------------------------------
+//! A whole symbol table decoded into one array per field.
+//! Names point into the string table section and live as long as it does.
+struct symbol_table
+{
+    std::vector<std::string_view> names;
+    std::vector<Elf64_Addr>       values;
+    std::vector<Elf_Xword>        sizes;
+    std::vector<unsigned char>    binds;
+    std::vector<unsigned char>    types;
+    std::vector<Elf_Half>         sections;
+    std::vector<unsigned char>    others;
+
+    //------------------------------------------------------------------------------
+    size_t size() const noexcept { return values.size(); }
+
+    //------------------------------------------------------------------------------
+    void resize( size_t num )
+    {
+        names.resize( num );
+        values.resize( num );
+        sizes.resize( num );
+        binds.resize( num );
+        types.resize( num );
+        sections.resize( num );
+        others.resize( num );
+    }
+};
+
 //------------------------------------------------------------------------------
 template <class S> class symbol_section_accessor_template
 {
@@ -87,6 +116,18 @@ template <class S> class symbol_section_accessor_template
         return ret;
     }
 
+    //------------------------------------------------------------------------------
+    //! Decodes every symbol in one pass instead of one get_symbol call each
+    bool get_symbols( symbol_table& table ) const
+    {
+        if ( elf_file.get_class() == ELFCLASS32 ) {
+            return generic_get_symbols<Elf32_Sym>( table );
+        }
+        else {
+            return generic_get_symbols<Elf64_Sym>( table );
+        }
+    }
+
     //------------------------------------------------------------------------------
     bool get_symbol( const std::string& name,
                      Elf64_Addr&        value,
@@ -425,6 +466,111 @@ template <class S> class symbol_section_accessor_template
         return false;
     }
 
+    //------------------------------------------------------------------------------
+    template <class T> bool generic_get_symbols( symbol_table& table ) const
+    {
+        Elf_Xword   num  = get_symbols_num();
+        const char* data = symbol_section->get_data();
+        table.resize( 0 );
+        if ( num == 0 ) {
+            return true;
+        }
+        if ( nullptr == data ) {
+            return false;
+        }
+
+        std::vector<Elf_Word> name_offsets( num );
+        table.resize( num );
+        if ( elf_file.get_convertor().is_converting() ) {
+            generic_get_symbols<T, true>( table, name_offsets, data );
+        }
+        else {
+            generic_get_symbols<T, false>( table, name_offsets, data );
+        }
+
+        // Names are resolved separately to keep the decoding loop branch free
+        const section* string_section =
+            elf_file.sections[get_string_table_index()];
+        const char* strings = nullptr;
+        size_t      strings_size = 0;
+        if ( nullptr != string_section ) {
+            strings      = string_section->get_data();
+            strings_size = string_section->get_size();
+        }
+        for ( Elf_Xword i = 0; i < num; ++i ) {
+            Elf_Word offset = name_offsets[i];
+            if ( nullptr != strings && offset < strings_size ) {
+                size_t length =
+                    strnlen( strings + offset, strings_size - offset );
+                if ( length < strings_size - offset ) {
+                    table.names[i] = std::string_view( strings + offset, length );
+                }
+            }
+        }
+
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    template <class T, bool swap>
+    void generic_get_symbols( symbol_table&          table,
+                              std::vector<Elf_Word>& name_offsets,
+                              const char*            data ) const
+    {
+        Elf_Xword entry_size = symbol_section->get_entry_size();
+        // Packed entries get a constant stride so the loop can be vectorized
+        if ( entry_size == sizeof( T ) ) {
+            generic_decode_symbols<T, swap>( data, sizeof( T ), table,
+                                             name_offsets.data() );
+        }
+        else {
+            generic_decode_symbols<T, swap>( data, entry_size, table,
+                                             name_offsets.data() );
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    template <class T, bool swap>
+    static void generic_decode_symbols( const char*   data,
+                                        Elf_Xword     entry_size,
+                                        symbol_table& table,
+                                        Elf_Word*     name_offsets ) noexcept
+    {
+        // One loop per field keeps every loop at a single element width
+        Elf_Xword num = table.size();
+        decode_field<T, swap>( data, entry_size, num, &T::st_name,
+                               name_offsets );
+        decode_field<T, swap>( data, entry_size, num, &T::st_value,
+                               table.values.data() );
+        decode_field<T, swap>( data, entry_size, num, &T::st_size,
+                               table.sizes.data() );
+        decode_field<T, swap>( data, entry_size, num, &T::st_info,
+                               table.binds.data() );
+        decode_field<T, swap>( data, entry_size, num, &T::st_other,
+                               table.others.data() );
+        decode_field<T, swap>( data, entry_size, num, &T::st_shndx,
+                               table.sections.data() );
+        for ( Elf_Xword i = 0; i < num; ++i ) {
+            unsigned char info = table.binds[i];
+            table.binds[i]     = ELF_ST_BIND( info );
+            table.types[i]     = ELF_ST_TYPE( info );
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    template <class T, bool swap, class F, class O>
+    static void decode_field( const char* data,
+                              Elf_Xword   entry_size,
+                              Elf_Xword   num,
+                              F T::*field,
+                              O*          out ) noexcept
+    {
+        for ( Elf_Xword i = 0; i < num; ++i ) {
+            const T* pSym = reinterpret_cast<const T*>( data + i * entry_size );
+            out[i]        = O( bulk_convert<swap>( pSym->*field ) );
+        }
+    }
+
     //------------------------------------------------------------------------------
     template <class T>
     bool generic_get_symbol( Elf_Xword      index,
@@ -25,6 +25,7 @@ THE SOFTWARE.
 
 #include <cstdint>
 #include <ostream>
+#include <type_traits>
 
 #define ELFIO_GET_ACCESS_DECL( TYPE, NAME ) \
     virtual TYPE get_##NAME() const noexcept = 0
@@ -147,6 +148,9 @@ class endianess_convertor
     //------------------------------------------------------------------------------
     uint8_t operator()( uint8_t value ) const { return value; }
 
+    //------------------------------------------------------------------------------
+    bool is_converting() const { return need_conversion; }
+
     //------------------------------------------------------------------------------
   private:
     //------------------------------------------------------------------------------
@@ -165,6 +169,41 @@ class endianess_convertor
     bool need_conversion = false;
 };
 
+//------------------------------------------------------------------------------
+//! Unconditional byte swaps for the bulk table decoders. The decoders pick
+//! whether to swap once per table, so their loops are branch free and the
+//! compiler can turn them into SIMD shuffles.
+inline uint16_t byteswap( uint16_t value ) noexcept
+{
+    return (uint16_t)( ( value << 8 ) | ( value >> 8 ) );
+}
+
+//------------------------------------------------------------------------------
+inline uint32_t byteswap( uint32_t value ) noexcept
+{
+    return ( ( value & 0x000000FF ) << 24 ) | ( ( value & 0x0000FF00 ) << 8 ) |
+           ( ( value & 0x00FF0000 ) >> 8 ) | ( ( value & 0xFF000000 ) >> 24 );
+}
+
+//------------------------------------------------------------------------------
+inline uint64_t byteswap( uint64_t value ) noexcept
+{
+    return ( (uint64_t)byteswap( (uint32_t)value ) << 32 ) |
+           byteswap( (uint32_t)( value >> 32 ) );
+}
+
+//------------------------------------------------------------------------------
+template <bool swap, class T> T bulk_convert( T value ) noexcept
+{
+    if constexpr ( swap && sizeof( T ) > 1 ) {
+        using U = std::make_unsigned_t<T>;
+        return T( byteswap( U( value ) ) );
+    }
+    else {
+        return value;
+    }
+}
+
 //------------------------------------------------------------------------------
 struct address_translation
 {
@@ -2,15 +2,14 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <set>
+#include <algorithm>
+#include <fstream>
 #include <stdio.h>
+#include <string.h>
 #include <elfio/elfio.hpp>
-
-typedef struct uso_symbol {
-    uint32_t name_ofs; //Relative to first symbol in symbol table
-    uint32_t addr;
-    uint16_t section;
-    uint16_t name_len; //Top bit used to tell if symbol is weak
-} uso_symbol_t;
+#include "uso_format.h"
+#include "tool_io.h"
 
 struct symbol_info {
     ELFIO::Elf_Word src_symbol;
@@ -22,6 +21,22 @@ struct symbol_info {
 
 std::vector<symbol_info> export_sym_list; //Global symbol table
 
+//Minimal perfect hash info
+uint32_t hash_seed;
+std::vector<uint32_t> hash_buckets; //Displacement per bucket
+std::vector<uint32_t> hash_slots; //Symbol index per slot
+
+//Pruning info
+bool prune_syms = false; //Only export symbols in used_sym_set when set
+std::set<std::string> used_sym_set; //Names imported by USOs or in keep list
+std::vector<std::string> dropped_sym_list; //Symbols removed by pruning
+size_t dropped_sym_bytes = 0; //Symbol table bytes saved by pruning
+uint32_t main_gp = 0; //Value of _gp for GP-relative relocations in USOs
+bool report_dropped_syms = false;
+
+//Don't touch output if its contents would not change
+bool skip_identical_output = false;
+
 //ELF info
 ELFIO::elfio elf_reader;
 ELFIO::Elf_Half elf_symbol_sec_index;
@@ -93,20 +108,22 @@ bool sym_compare(symbol_info &first, symbol_info &second)
 void sym_collect()
 {
     ELFIO::symbol_section_accessor sym_accessor(elf_reader, elf_reader.sections[elf_symbol_sec_index]);
-    for (ELFIO::Elf_Xword i = 0; i < sym_accessor.get_symbols_num(); i++) {
-        //Symbol temporaries
-        std::string name;
-        ELFIO::Elf64_Addr value;
-        ELFIO::Elf_Xword size;
-        unsigned char bind;
-        unsigned char type;
-        ELFIO::Elf_Half section_index;
-        unsigned char other;
-        sym_accessor.get_symbol(i, name, value, size, bind, type, section_index, other);
+    ELFIO::symbol_table syms;
+    sym_accessor.get_symbols(syms);
+    for (ELFIO::Elf_Xword i = 0; i < syms.size(); i++) {
+        ELFIO::Elf64_Addr value = syms.values[i];
+        //GP is written to the header instead of the symbol table
+        if (syms.names[i] == "_gp") {
+            main_gp = value;
+            continue;
+        }
         //Skip local symbols
-        if (bind == ELFIO::STB_LOCAL) {
+        if (syms.binds[i] == ELFIO::STB_LOCAL) {
             continue;
         }
+        //Symbol temporaries
+        std::string name(syms.names[i]);
+        ELFIO::Elf_Half section_index = syms.sections[i];
         //Reject defined NULL symbols
         if (section_index != ELFIO::SHN_UNDEF && value == 0) {
             std::cout << "Symbol " << name << " has NULL address." << std::endl;
@@ -120,6 +137,12 @@ void sym_collect()
             std::cout << "Symbol ID " << i << " has too long of a name" << std::endl;
         }
         if (sym_is_exported(name)) {
+            //Drop symbols no USO imports when pruning
+            if (prune_syms && used_sym_set.find(name) == used_sym_set.end()) {
+                dropped_sym_list.push_back(name);
+                dropped_sym_bytes += 8 + name.length(); //Address, hash slot, and uncompressed name
+                continue;
+            }
             symbol_info symbol;
             //Populare symbol
             symbol.src_symbol = i;
@@ -134,100 +157,328 @@ void sym_collect()
     std::sort(export_sym_list.begin(), export_sym_list.end(), sym_compare);
 }
 
-bool need_swap()
+void sym_report_dropped()
+{
+    if (!prune_syms) {
+        return;
+    }
+    std::cout << "Dropped " << dropped_sym_list.size() << " unused global symbols (" << dropped_sym_bytes << " bytes), ";
+    std::cout << "kept " << export_sym_list.size() << "." << std::endl;
+    if (report_dropped_syms) {
+        //List dropped symbols in name order
+        std::sort(dropped_sym_list.begin(), dropped_sym_list.end());
+        for (size_t i = 0; i < dropped_sym_list.size(); i++) {
+            std::cout << "  " << dropped_sym_list[i] << std::endl;
+        }
+    }
+}
+
+//Hash must match runtime lookup in uso.c
+void hash_name(const std::string &name, uint32_t seed, uint32_t &h1, uint32_t &h2)
+{
+    h1 = 0x811C9DC5 ^ seed;
+    h2 = 0x9E3779B9 + seed;
+    for (size_t i = 0; i < name.length(); i++) {
+        uint8_t c = name[i];
+        h1 = (h1 ^ c) * 0x01000193;
+        h2 = (h2 ^ c) * 0x5BD1E995;
+    }
+}
+
+uint32_t hash_mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+uint32_t hash_get_slot(uint32_t h2, uint32_t displacement, uint32_t num_slots)
+{
+    return hash_mix(h2 + (displacement * 0x9E3779B9)) % num_slots;
+}
+
+bool hash_try_build(uint32_t seed)
 {
-    static const uint32_t value = 1;
-    //Little endian has first byte equal to lowest 8 bits
-    if (*(uint8_t *)(&value) == 1) {
-        //Swap on little endian
+    uint32_t num_syms = export_sym_list.size();
+    uint32_t num_buckets = (num_syms + 3) / 4; //Average of 4 symbols per bucket
+    std::vector<std::vector<uint32_t>> bucket_syms(num_buckets);
+    std::vector<uint32_t> sym_h2(num_syms);
+    //Distribute symbols into buckets
+    for (uint32_t i = 0; i < num_syms; i++) {
+        uint32_t h1;
+        hash_name(export_sym_list[i].name, seed, h1, sym_h2[i]);
+        bucket_syms[hash_mix(h1) % num_buckets].push_back(i);
+    }
+    //Place largest buckets first while most slots are free
+    std::vector<uint32_t> bucket_order(num_buckets);
+    for (uint32_t i = 0; i < num_buckets; i++) {
+        bucket_order[i] = i;
+    }
+    std::stable_sort(bucket_order.begin(), bucket_order.end(), [&](uint32_t a, uint32_t b) {
+        return bucket_syms[a].size() > bucket_syms[b].size();
+    });
+    hash_buckets.assign(num_buckets, 0);
+    hash_slots.assign(num_syms, UINT32_MAX);
+    std::vector<uint32_t> bucket_slots;
+    for (uint32_t i = 0; i < num_buckets; i++) {
+        std::vector<uint32_t> &syms = bucket_syms[bucket_order[i]];
+        if (syms.empty()) {
+            break;
+        }
+        //Search for displacement placing all bucket symbols in free distinct slots
+        uint32_t max_displacement = num_syms * 64;
+        uint32_t displacement;
+        for (displacement = 0; displacement < max_displacement; displacement++) {
+            bucket_slots.clear();
+            for (size_t j = 0; j < syms.size(); j++) {
+                uint32_t slot = hash_get_slot(sym_h2[syms[j]], displacement, num_syms);
+                if (hash_slots[slot] != UINT32_MAX || std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end()) {
+                    break;
+                }
+                bucket_slots.push_back(slot);
+            }
+            if (bucket_slots.size() == syms.size()) {
+                break;
+            }
+        }
+        if (displacement == max_displacement) {
+            //Symbols with identical hashes cannot be separated with this seed
+            return false;
+        }
+        //Assign slots
+        hash_buckets[bucket_order[i]] = displacement;
+        for (size_t j = 0; j < syms.size(); j++) {
+            hash_slots[bucket_slots[j]] = syms[j];
+        }
+    }
+    hash_seed = seed;
+    return true;
+}
+
+bool hash_build()
+{
+    //Empty symbol tables have no hash buckets
+    if (export_sym_list.size() == 0) {
+        hash_seed = 0;
         return true;
     }
-    //Don't swap on big endian
+    //Try new seeds until a minimal perfect hash is found
+    for (uint32_t seed = 0; seed < 64; seed++) {
+        if (hash_try_build(seed)) {
+            return true;
+        }
+    }
+    std::cout << "Failed to build global symbol hash." << std::endl;
     return false;
 }
 
-void swap_u16(uint16_t *ptr)
+uint32_t sym_get_fingerprint()
+{
+    //FNV-1a over GP then every symbol name and address
+    uint32_t hash = 0x811C9DC5;
+    for (int j = 24; j >= 0; j -= 8) {
+        hash = (hash ^ (uint8_t)(main_gp >> j)) * 0x01000193;
+    }
+    for (size_t i = 0; i < export_sym_list.size(); i++) {
+        std::string &name = export_sym_list[i].name;
+        for (size_t j = 0; j <= name.length(); j++) {
+            hash = (hash ^ (uint8_t)name.c_str()[j]) * 0x01000193;
+        }
+        for (int j = 24; j >= 0; j -= 8) {
+            hash = (hash ^ (uint8_t)(export_sym_list[i].addr >> j)) * 0x01000193;
+        }
+    }
+    //Zero is reserved for USOs not bound to a global symbol table
+    if (hash == 0) {
+        hash = 1;
+    }
+    return hash;
+}
+
+bool uso_read_import_table(mapped_file &file, uint32_t ofs)
 {
-    if (need_swap()) {
-        *ptr = (((*ptr >> 8) & 0xFF) << 0) | (((*ptr >> 0) & 0xFF) << 8);
+    //Skip reading 0-offset symbol tables
+    if (ofs == 0) {
+        return true;
+    }
+    be_u32 num_symbols;
+    if (!file_read(file, ofs, &num_symbols, sizeof(num_symbols)) || num_symbols > file.size / sizeof(uso_symbol_t)) {
+        return false;
+    }
+    //Read whole symbol table at once
+    std::vector<uso_symbol_t> symbols(num_symbols);
+    if (num_symbols != 0 && !file_read(file, ofs + 4, symbols.data(), symbols.size() * sizeof(uso_symbol_t))) {
+        return false;
+    }
+    for (uint32_t i = 0; i < num_symbols; i++) {
+        uint32_t name_ofs = ofs + symbols[i].name_ofs;
+        uint32_t name_len = symbols[i].name_len & USO_SYMBOL_NAME_LEN_MASK;
+        if (name_ofs > file.size || name_len > file.size - name_ofs) {
+            return false;
+        }
+        //Copy name straight out of mapped file
+        used_sym_set.insert(std::string((const char *)file.data + name_ofs, name_len));
+    }
+    return true;
+}
+
+bool uso_read_imports(const char *path)
+{
+    mapped_file file;
+    if (!file_map(path, file)) {
+        std::cout << "Failed to open " << path << " for reading." << std::endl;
+        return false;
+    }
+    uso_header_t header;
+    if (!file_read(file, 0, &header, sizeof(uso_header_t))) {
+        std::cout << "Failed to read USO header of " << path << "." << std::endl;
+        file_unmap(file);
+        return false;
     }
+    if (!uso_read_import_table(file, header.import_sym_table_ofs)) {
+        std::cout << "Failed to read import symbols of " << path << "." << std::endl;
+        file_unmap(file);
+        return false;
+    }
+    file_unmap(file);
+    return true;
 }
 
-void swap_u32(uint32_t *ptr)
+bool keep_list_read(const char *path)
 {
-    if (need_swap()) {
-        *ptr = (((*ptr >> 24) & 0xFF) << 0) | (((*ptr >> 16) & 0xFF) << 8)
-            | (((*ptr >> 8) & 0xFF) << 16) | (((*ptr >> 0) & 0xFF) << 24);
+    std::vector<std::string> names;
+    if (!name_list_read(path, names)) {
+        std::cout << "Failed to open " << path << " for reading." << std::endl;
+        return false;
     }
+    used_sym_set.insert(names.begin(), names.end());
+    return true;
 }
 
-void uso_write_symbol_table_count(FILE *file, uint32_t ofs, uint32_t count)
+void buffer_write_u32_array(std::vector<uint8_t> &buf, uint32_t ofs, std::vector<uint32_t> &values)
 {
-    swap_u32(&count); //Convert count to big endian
-    //Write count to offset
-    fseek(file, ofs, SEEK_SET);
-    fwrite(&count, 1, 4, file);
+    //Copy values then convert them in place
+    memcpy(&buf[ofs], values.data(), values.size() * 4);
+    big_endian_convert_array((uint32_t *)&buf[ofs], values.size());
 }
 
-void uso_write_symbol_table(FILE *file, uint32_t ofs, std::vector<symbol_info> &syms)
+void names_write_varint(std::string &names, uint32_t value)
 {
-    uint32_t name_ofs = 4 + (syms.size() * sizeof(uso_symbol_t));
-    //Write symbol table count
-    uso_write_symbol_table_count(file, ofs, syms.size());
-    //Iterate over symbols
-    for (size_t i = 0; i < syms.size(); i++) {
-        //Setup symbol data
-        uint16_t name_len = syms[i].name.length();
-        uso_symbol_t temp_sym;
-        temp_sym.name_ofs = name_ofs;
-        temp_sym.addr = syms[i].addr;
-        temp_sym.section = syms[i].section;
-        //Set name length depending on weak flag
-        if (syms[i].weak) {
-            temp_sym.name_len = name_len | 0x8000;
+    //Write 7 bits per byte with top bit set when more bytes follow
+    while (value >= 0x80) {
+        names += (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    names += (char)value;
+}
+
+void names_build(std::string &names, std::vector<uint32_t> &restarts)
+{
+    //Front code sorted names with full names at each restart point
+    for (size_t i = 0; i < export_sym_list.size(); i++) {
+        std::string &name = export_sym_list[i].name;
+        size_t shared = 0;
+        if (i % USO_GLOBAL_RESTART_INTERVAL == 0) {
+            restarts.push_back(names.length());
         } else {
-            temp_sym.name_len = name_len;
+            //Count prefix shared with previous name
+            std::string &prev_name = export_sym_list[i - 1].name;
+            while (shared < name.length() && shared < prev_name.length() && name[shared] == prev_name[shared]) {
+                shared++;
+            }
         }
-        //byteswap symbol data
-        swap_u32(&temp_sym.name_ofs);
-        swap_u32(&temp_sym.addr);
-        swap_u16(&temp_sym.section);
-        swap_u16(&temp_sym.name_len);
-        //Write symbol data
-        fseek(file, 4 + ofs + (i * sizeof(uso_symbol_t)), SEEK_SET);
-        fwrite(&temp_sym, sizeof(uso_symbol_t), 1, file);
-        //Write symbol name with NULL terminator
-        fseek(file, ofs + name_ofs, SEEK_SET);
-        fwrite(syms[i].name.c_str(), 1, name_len + 1, file);
-        name_ofs += name_len + 1; //Calculate next name offset
+        //Write shared prefix length, suffix length, and suffix
+        names_write_varint(names, shared);
+        names_write_varint(names, name.length() - shared);
+        names.append(name, shared, std::string::npos);
     }
 }
 
 bool global_sym_write(const char *path)
 {
-    //Try to open file
-    FILE *file = fopen(path, "wb");
-    if (!file) {
-        std::cout << "Failed to open " << path << " for writing." << std::endl;
-        return false;
+    //Build symbol data
+    std::vector<uint32_t> addrs;
+    std::vector<uint32_t> restarts;
+    std::string names;
+    for (size_t i = 0; i < export_sym_list.size(); i++) {
+        addrs.push_back(export_sym_list[i].addr);
     }
-    //Write symbol table
-    uso_write_symbol_table(file, 0, export_sym_list);
-    fclose(file);
-    return true;
+    names_build(names, restarts);
+    //Calculate table offsets
+    uso_global_table_t header;
+    header.num_syms = export_sym_list.size();
+    header.hash_seed = hash_seed;
+    header.num_buckets = hash_buckets.size();
+    header.buckets_ofs = sizeof(uso_global_table_t);
+    header.slots_ofs = header.buckets_ofs + (hash_buckets.size() * 4);
+    header.addrs_ofs = header.slots_ofs + (hash_slots.size() * 4);
+    header.restarts_ofs = header.addrs_ofs + (addrs.size() * 4);
+    header.names_ofs = header.restarts_ofs + (restarts.size() * 4);
+    header.fingerprint = sym_get_fingerprint();
+    header.gp = main_gp;
+    //Lay out whole table in memory
+    std::vector<uint8_t> buf(header.names_ofs + names.length());
+    buffer_write_u32_array(buf, header.buckets_ofs, hash_buckets);
+    buffer_write_u32_array(buf, header.slots_ofs, hash_slots);
+    buffer_write_u32_array(buf, header.addrs_ofs, addrs);
+    buffer_write_u32_array(buf, header.restarts_ofs, restarts);
+    memcpy(&buf[header.names_ofs], names.data(), names.length());
+    //Write header
+    memcpy(&buf[0], &header, sizeof(uso_global_table_t));
+    //Write whole table at once unless it would not change
+    return file_write(path, buf.data(), buf.size(), skip_identical_output, std::cout);
+}
+
+void print_usage(char *name)
+{
+    std::cout << "Usage: " << name << " [-k keep_list] [-v] [-u] elf_input syms_output [uso_list]" << std::endl;
+    std::cout << "elf_input is a non-relocatable N64 ELF file." << std::endl;
+    std::cout << "The global symbols from elf_input will be written to syms_output." << std::endl;
+    std::cout << "uso_list is a possibly empty space separated list of USO files." << std::endl;
+    std::cout << "When uso_list or keep_list is given only symbols imported by a USO or named" << std::endl;
+    std::cout << "in keep_list (one symbol per line) are written." << std::endl;
+    std::cout << "-v lists every symbol dropped from the global symbol table." << std::endl;
+    std::cout << "-u leaves syms_output untouched if its contents would not change." << std::endl;
 }
 
 int main(int argc, char **argv)
 {
-    if (argc != 3) {
-        //Write usage
-        std::cout << "Usage: " << argv[0] << " elf_input syms_output" << std::endl;
-        std::cout << "elf_input is a non-relocatable N64 ELF file." << std::endl;
-        std::cout << "The global symbols from elf_input will be written to syms_output." << std::endl;
+    int arg_idx = 1;
+    //Parse options
+    while (arg_idx < argc && argv[arg_idx][0] == '-') {
+        std::string option = argv[arg_idx++];
+        if (option == "-k" && arg_idx < argc) {
+            if (!keep_list_read(argv[arg_idx++])) {
+                return 1;
+            }
+            prune_syms = true;
+        } else if (option == "-v") {
+            report_dropped_syms = true;
+        } else if (option == "-u") {
+            skip_identical_output = true;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - arg_idx < 2) {
+        print_usage(argv[0]);
         return 1;
     }
-    //Try to load ELF
-    if (!elf_reader.load(argv[1])) {
+    const char *elf_path = argv[arg_idx];
+    const char *syms_path = argv[arg_idx + 1];
+    //Collect imports of USOs passed in on command line
+    for (int i = arg_idx + 2; i < argc; i++) {
+        if (!uso_read_imports(argv[i])) {
+            return 1;
+        }
+        prune_syms = true;
+    }
+    //Try to load ELF (sections are only read once accessed)
+    if (!elf_reader.load_mapped(elf_path)) {
         std::cout << "Failed to read input ELF file." << std::endl;
         return 1;
     }
@@ -237,8 +488,12 @@ int main(int argc, char **argv)
         return 1;
     }
     sym_collect();
+    sym_report_dropped();
+    if (!hash_build()) {
+        return 1;
+    }
     //Write global symbols and return status
-    if (!global_sym_write(argv[2])) {
+    if (!global_sym_write(syms_path)) {
         return 1;
     }
     return 0;
@@ -0,0 +1,277 @@
+#define _CRT_SECURE_NO_WARNINGS //Shut up Visual Studio
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <fstream>
+#include "uso_format.h"
+#include "tool_io.h"
+
+//USO bundle structure definitions
+
+typedef struct uso_bundle_entry {
+    be_u32 name_hash; //FNV-1a hash of name
+    be_u32 name_ofs; //Relative to bundle
+    be_u32 data_ofs; //Relative to bundle
+    uso_load_info_t load_info; //Copy of load info at end of USO image
+} uso_bundle_entry_t;
+
+typedef struct uso_bundle_header {
+    be_u32 magic;
+    be_u32 num_entries;
+    be_u32 num_buckets; //Power of 2
+    be_u32 buckets_ofs; //Relative to bundle, first entry of each bucket followed by num_entries
+    be_u32 entries_ofs; //Relative to bundle
+    be_u32 index_size; //Size of header, buckets, entries, and names
+} uso_bundle_header_t;
+
+static_assert(sizeof(uso_bundle_entry_t) == USO_BUNDLE_ENTRY_SIZE, "Invalid uso_bundle_entry_t size.");
+static_assert(sizeof(uso_bundle_header_t) == USO_BUNDLE_HEADER_SIZE, "Invalid uso_bundle_header_t size.");
+
+struct bundle_uso {
+    std::string name; //Path relative to filesystem root
+    std::vector<char> data; //USO image without load info
+    uso_load_info_t load_info;
+    uint32_t name_hash;
+};
+
+std::vector<bundle_uso> uso_list; //USOs in load order
+
+//Hash must match uso.c
+uint32_t name_hash(const std::string &name)
+{
+    uint32_t hash = 0x811C9DC5;
+    for (size_t i = 0; i < name.length(); i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+uint32_t align_val(uint32_t val, uint32_t to)
+{
+    //Only supports power of 2 alignment
+    return (val + to - 1) & ~(to - 1);
+}
+
+std::string uso_get_name(const std::string &path, const std::string &root)
+{
+    //Paths under root are named relative to it and others by file name
+    if (!root.empty() && path.compare(0, root.length(), root) == 0 && path[root.length()] == '/') {
+        return path.substr(root.length() + 1);
+    }
+    size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos) {
+        return path;
+    }
+    return path.substr(slash + 1);
+}
+
+bool uso_read(const char *path, const std::string &root)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << path << " for reading." << std::endl;
+        return false;
+    }
+    bundle_uso uso;
+    uso.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    //Load info at end of USO must describe rest of file
+    if (uso.data.size() < sizeof(uso_header_t) + sizeof(uso_load_info_t)) {
+        std::cerr << "Invalid USO " << path << "." << std::endl;
+        return false;
+    }
+    memcpy(&uso.load_info, &uso.data[uso.data.size() - sizeof(uso_load_info_t)], sizeof(uso_load_info_t));
+    uso_header_t header;
+    memcpy(&header, uso.data.data(), sizeof(uso_header_t));
+    //Unwind sections left in ROM sit between loaded image and load info
+    uint32_t image_size = uso.load_info.uso_size;
+    if (header.unwind_size != 0) {
+        image_size = header.unwind_ofs + header.unwind_size;
+    }
+    if (align_val(image_size, 2) != uso.data.size() - sizeof(uso_load_info_t)) {
+        std::cerr << "Invalid USO " << path << "." << std::endl;
+        return false;
+    }
+    //Load info is kept in bundle index instead
+    uso.data.resize(image_size);
+    uso.name = uso_get_name(path, root);
+    uso.name_hash = name_hash(uso.name);
+    uso_list.push_back(uso);
+    return true;
+}
+
+bool load_order_read(const char *path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << path << " for reading." << std::endl;
+        return false;
+    }
+    std::vector<bundle_uso> ordered;
+    std::string line;
+    while (std::getline(file, line)) {
+        //Strip carriage returns and surrounding whitespace
+        size_t start = line.find_first_not_of(" \t\r");
+        size_t end = line.find_last_not_of(" \t\r");
+        //Skip empty lines and comments
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        std::string name = line.substr(start, end - start + 1);
+        //Move USO to end of ordered list, names not in bundle are ignored
+        for (size_t i = 0; i < uso_list.size(); i++) {
+            if (uso_list[i].name == name) {
+                ordered.push_back(std::move(uso_list[i]));
+                uso_list.erase(uso_list.begin() + i);
+                break;
+            }
+        }
+    }
+    //USOs missing from load order keep command line order after ordered USOs
+    for (size_t i = 0; i < uso_list.size(); i++) {
+        ordered.push_back(std::move(uso_list[i]));
+    }
+    uso_list = std::move(ordered);
+    return true;
+}
+
+bool uso_check_names()
+{
+    std::map<std::string, size_t> names;
+    for (size_t i = 0; i < uso_list.size(); i++) {
+        if (!names.insert(std::make_pair(uso_list[i].name, i)).second) {
+            std::cerr << "USO name " << uso_list[i].name << " is used more than once." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void buffer_write(std::vector<uint8_t> &buf, uint32_t ofs, const void *data, size_t size)
+{
+    memcpy(&buf[ofs], data, size);
+}
+
+void bundle_build(std::vector<uint8_t> &buf)
+{
+    //Use about one entry per bucket
+    uint32_t num_buckets = 1;
+    while (num_buckets < uso_list.size()) {
+        num_buckets *= 2;
+    }
+    //Count entries in each bucket then turn counts into first entry of each bucket
+    std::vector<uint32_t> buckets(num_buckets + 1, 0);
+    for (size_t i = 0; i < uso_list.size(); i++) {
+        buckets[(uso_list[i].name_hash & (num_buckets - 1)) + 1]++;
+    }
+    for (uint32_t i = 0; i < num_buckets; i++) {
+        buckets[i + 1] += buckets[i];
+    }
+    //Lay out index
+    uso_bundle_header_t header;
+    header.magic = USO_BUNDLE_MAGIC;
+    header.num_entries = uso_list.size();
+    header.num_buckets = num_buckets;
+    header.buckets_ofs = sizeof(uso_bundle_header_t);
+    header.entries_ofs = header.buckets_ofs + (buckets.size() * 4);
+    uint32_t names_ofs = header.entries_ofs + (uso_list.size() * sizeof(uso_bundle_entry_t));
+    uint32_t index_size = names_ofs;
+    for (size_t i = 0; i < uso_list.size(); i++) {
+        index_size += uso_list[i].name.length() + 1;
+    }
+    index_size = align_val(index_size, USO_BUNDLE_DATA_ALIGN);
+    header.index_size = index_size;
+    //Lay out names and USO images in load order after index
+    std::vector<uint32_t> uso_name_ofs(uso_list.size());
+    std::vector<uint32_t> uso_data_ofs(uso_list.size());
+    uint32_t data_ofs = index_size;
+    for (size_t i = 0; i < uso_list.size(); i++) {
+        uso_name_ofs[i] = names_ofs;
+        uso_data_ofs[i] = data_ofs;
+        names_ofs += uso_list[i].name.length() + 1;
+        data_ofs = align_val(data_ofs + uso_list[i].data.size(), USO_BUNDLE_DATA_ALIGN);
+    }
+    //Place each entry in next free slot of its bucket
+    std::vector<uso_bundle_entry_t> entries(uso_list.size());
+    std::vector<uint32_t> next_entry(buckets.begin(), buckets.end() - 1);
+    for (size_t i = 0; i < uso_list.size(); i++) {
+        uso_bundle_entry_t &entry = entries[next_entry[uso_list[i].name_hash & (num_buckets - 1)]++];
+        entry.name_hash = uso_list[i].name_hash;
+        entry.name_ofs = uso_name_ofs[i];
+        entry.data_ofs = uso_data_ofs[i];
+        entry.load_info = uso_list[i].load_info;
+    }
+    //Write whole bundle
+    buf.assign(data_ofs, 0);
+    buffer_write(buf, 0, &header, sizeof(uso_bundle_header_t));
+    big_endian_convert_array(buckets.data(), buckets.size());
+    buffer_write(buf, header.buckets_ofs, buckets.data(), buckets.size() * 4);
+    buffer_write(buf, header.entries_ofs, entries.data(), entries.size() * sizeof(uso_bundle_entry_t));
+    for (size_t i = 0; i < uso_list.size(); i++) {
+        buffer_write(buf, uso_name_ofs[i], uso_list[i].name.c_str(), uso_list[i].name.length() + 1);
+        buffer_write(buf, uso_data_ofs[i], uso_list[i].data.data(), uso_list[i].data.size());
+    }
+}
+
+bool bundle_write(const char *path)
+{
+    std::vector<uint8_t> buf;
+    bundle_build(buf);
+    //Leave output untouched if it already has the same contents
+    return file_write(path, buf.data(), buf.size(), true, std::cerr);
+}
+
+void print_usage(char *name)
+{
+    std::cout << "Usage: " << name << " [-d root] [-l load_order] output uso_list" << std::endl;
+    std::cout << "output receives every USO in uso_list along with an index hashed by name." << std::endl;
+    std::cout << "USOs are named by path relative to root or by file name if they are outside root." << std::endl;
+    std::cout << "load_order lists USO names one per line in the order they are usually opened." << std::endl;
+    std::cout << "USOs are laid out in load order followed by the rest in the order they are passed in." << std::endl;
+    std::cout << "output is left untouched if its contents would not change." << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    int arg_idx = 1;
+    std::string root;
+    char *load_order_path = NULL;
+    //Parse options
+    while (arg_idx < argc && argv[arg_idx][0] == '-') {
+        std::string option = argv[arg_idx++];
+        if (option == "-d" && arg_idx < argc) {
+            root = argv[arg_idx++];
+            //Trailing separators are not part of root
+            while (!root.empty() && root.back() == '/') {
+                root.pop_back();
+            }
+        } else if (option == "-l" && arg_idx < argc) {
+            load_order_path = argv[arg_idx++];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - arg_idx < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    //Read in USOs passed in on command line
+    for (int i = arg_idx + 1; i < argc; i++) {
+        if (!uso_read(argv[i], root)) {
+            return 1;
+        }
+    }
+    if (!uso_check_names()) {
+        return 1;
+    }
+    if (load_order_path && !load_order_read(load_order_path)) {
+        return 1;
+    }
+    if (!bundle_write(argv[arg_idx])) {
+        return 1;
+    }
+    return 0;
+}
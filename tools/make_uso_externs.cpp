@@ -1,25 +1,18 @@
 #define _CRT_SECURE_NO_WARNINGS //Shut up Visual Studio
 #include <stdio.h>
+#include <string.h>
 #include <iostream>
 #include <vector>
 #include <algorithm>
-
-typedef struct uso_symbol {
-    uint32_t name_ofs; //Relative to first symbol in symbol table
-    uint32_t addr;
-    uint16_t section;
-    uint16_t name_len; //Top bit used to tell if symbol is weak
-} uso_symbol_t;
-
-typedef struct uso_header {
-    uint16_t num_sections;
-    uint16_t eh_frame_section;
-    uint32_t sections_ofs;
-    uint32_t import_sym_table_ofs;
-    uint32_t export_sym_table_ofs;
-    uint16_t ctors_section;
-    uint16_t dtors_section;
-} uso_header_t;
+#include <string>
+#include <unordered_set>
+#include <unordered_map>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include "uso_format.h"
+#include "tool_io.h"
 
 struct uso_symbol_info {
     std::string name;
@@ -33,206 +26,308 @@ struct uso_info {
     std::vector<uso_symbol_info> export_syms;
 };
 
+struct uso_cache_entry {
+    uint64_t hash; //Hash of whole USO file
+    uso_info info; //Only symbol names are kept
+};
+
 std::vector<uso_info> uso_list;
+//Summaries of USOs from previous run keyed by path
+std::unordered_map<std::string, uso_cache_entry> uso_cache;
+std::map<std::string, uso_cache_entry> uso_new_cache; //Sorted so cache contents are stable
+bool uso_cache_changed = false;
+std::unordered_set<std::string> uso_export_set; //Exports of every USO
 std::vector<std::string> uso_extern_list;
+std::set<std::string> uso_keep_export_set; //USO exports imported by a USO or in keep list
 
-bool file_read(FILE *file, uint32_t ofs, void *dst, uint32_t size)
-{
-    return fseek(file, ofs, SEEK_SET) == 0 && fread(dst, size, 1, file) != 0;
-}
-
-bool need_swap()
-{
-    static const uint32_t value = 1;
-    //Little endian has first byte equal to lowest 8 bits
-    if (*(uint8_t *)(&value) == 1) {
-        //Swap on little endian
-        return true;
-    }
-    //Don't swap on big endian
-    return false;
-}
-
-void swap_u16(uint16_t *ptr)
+bool file_write_if_changed(const char *path, const std::string &contents)
 {
-    if (need_swap()) {
-        *ptr = (((*ptr >> 8) & 0xFF) << 0) | (((*ptr >> 0) & 0xFF) << 8);
-    }
+    //Leave file untouched so targets depending on it are not rebuilt
+    return file_write(path, contents.data(), contents.length(), true, std::cerr);
 }
 
-void swap_u32(uint32_t *ptr)
-{
-    if (need_swap()) {
-        *ptr = (((*ptr >> 24) & 0xFF) << 0) | (((*ptr >> 16) & 0xFF) << 8)
-            | (((*ptr >> 8) & 0xFF) << 16) | (((*ptr >> 0) & 0xFF) << 24);
-    }
-}
-
-void uso_read_header(FILE *file, uso_header_t &header)
+void uso_read_header(mapped_file &file, uso_header_t &header)
 {
     //Try to read USO symbol
     if (!file_read(file, 0, &header, sizeof(uso_header_t))) {
         std::cerr << "Failed to read USO header." << std::endl;
-        fclose(file);
         exit(1);
     }
-    //Byteswap header
-    swap_u16(&header.num_sections);
-    swap_u16(&header.eh_frame_section);
-    swap_u32(&header.sections_ofs);
-    swap_u32(&header.import_sym_table_ofs);
-    swap_u32(&header.export_sym_table_ofs);
-    swap_u16(&header.ctors_section);
-    swap_u16(&header.dtors_section);
 }
 
-void uso_read_symbol(FILE *file, uint32_t ofs, uso_symbol_t &symbol)
+void uso_read_symbols(mapped_file &file, uint32_t ofs, std::vector<uso_symbol_t> &symbols)
 {
-    if (!file_read(file, ofs, &symbol, sizeof(uso_symbol_t))) {
-        std::cerr << "Failed to read USO symbol." << std::endl;
-        fclose(file);
+    //Read whole symbol table at once
+    if (symbols.size() > file.size / sizeof(uso_symbol_t)
+        || !file_read(file, ofs, symbols.data(), symbols.size() * sizeof(uso_symbol_t))) {
+        std::cerr << "Failed to read USO symbols." << std::endl;
         exit(1);
     }
-    //Byteswap symbol
-    swap_u32(&symbol.name_ofs);
-    swap_u32(&symbol.addr);
-    swap_u16(&symbol.section);
-    swap_u16(&symbol.name_len);
 }
 
-void uso_read_symbol_name(FILE *file, uint32_t ofs, uint32_t len, std::string &name)
+void uso_read_symbol_name(mapped_file &file, uint32_t ofs, uint32_t len, std::string &name)
 {
-    char temp_buf[32768];
-    //Read name from file to temporary buffer
-    if (!file_read(file, ofs, temp_buf, len)) {
+    if (ofs > file.size || len > file.size - ofs) {
         std::cerr << "Failed to read symbol name." << std::endl;
-        fclose(file);
         exit(1);
     }
-    temp_buf[len] = 0; //Add terminator to name
-    name = temp_buf; //Copy buffer to std::string
+    //Copy name straight out of mapped file
+    name.assign((const char *)file.data + ofs, len);
 }
 
-uint32_t uso_get_sym_table_count(FILE *file, uint32_t sym_table_ofs)
+uint32_t uso_get_sym_table_count(mapped_file &file, uint32_t sym_table_ofs)
 {
-    uint32_t size;
-    if (!file_read(file, sym_table_ofs, &size, 4)) {
+    be_u32 size;
+    if (!file_read(file, sym_table_ofs, &size, sizeof(size))) {
         std::cerr << "Failed to read symbol table size." << std::endl;
-        fclose(file);
         exit(1);
     }
-    swap_u32(&size);
     return size;
 }
 
-void uso_read_symbol_table(FILE *file, uint32_t ofs, std::vector<uso_symbol_info> &list)
+void uso_read_symbol_table(mapped_file &file, uint32_t ofs, std::vector<uso_symbol_info> &list)
 {
 	//Skip reading 0-offset symbol tables
 	if(ofs == 0) {
 		return;
 	}
-    uint32_t num_symbols = uso_get_sym_table_count(file, ofs);
-    for (uint32_t i = 0; i < num_symbols; i++) {
+    std::vector<uso_symbol_t> symbols(uso_get_sym_table_count(file, ofs));
+    uso_read_symbols(file, ofs + 4, symbols);
+    for (size_t i = 0; i < symbols.size(); i++) {
         uso_symbol_info sym_info;
-        uso_symbol_t symbol;
-        uso_read_symbol(file, 4 + ofs + (i * sizeof(uso_symbol_t)), symbol);
+        uso_symbol_t &symbol = symbols[i];
         sym_info.addr = symbol.addr;
         sym_info.section = symbol.section;
         //Determine weakness of symbol
-        if (symbol.name_len & 0x8000) {
+        if (symbol.name_len & USO_SYMBOL_WEAK) {
             sym_info.weak = true;
         } else {
             sym_info.weak = false;
         }
-        uso_read_symbol_name(file, ofs + symbol.name_ofs, symbol.name_len & 0x7FFF, sym_info.name);
+        uso_read_symbol_name(file, ofs + symbol.name_ofs, symbol.name_len & USO_SYMBOL_NAME_LEN_MASK, sym_info.name);
         list.push_back(sym_info);
     }
 }
 
+uint64_t file_hash(mapped_file &file)
+{
+    //Hash contents with 64-bit FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < file.size; i++) {
+        hash = (hash ^ file.data[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+void cache_read(const char *path)
+{
+    std::ifstream file(path);
+    //Missing cache is treated as empty
+    if (!file.is_open()) {
+        return;
+    }
+    std::string line;
+    uso_cache_entry *entry = NULL;
+    while (std::getline(file, line)) {
+        if (line.length() < 2) {
+            continue;
+        }
+        uso_symbol_info symbol = { line.substr(2), 0, 0, false };
+        if (line[0] == 'U' && line.length() >= 20) {
+            //USO line has hash then path
+            uso_cache_entry new_entry;
+            new_entry.hash = strtoull(line.substr(2, 16).c_str(), NULL, 16);
+            entry = &(uso_cache[line.substr(19)] = new_entry);
+        } else if (line[0] == 'I' && entry) {
+            entry->info.import_syms.push_back(symbol);
+        } else if (line[0] == 'E' && entry) {
+            entry->info.export_syms.push_back(symbol);
+        } else {
+            //Start over if cache is malformed
+            std::cerr << "Ignoring malformed USO cache " << path << "." << std::endl;
+            uso_cache.clear();
+            return;
+        }
+    }
+}
+
 bool uso_read(char *path)
 {
-    FILE *file = fopen(path, "rb");
-    if (!file) {
+    mapped_file file;
+    if (!file_map(path, file)) {
         std::cerr << "Failed to open " << path << " for reading." << std::endl;
         return false;
     }
-    uso_header_t header;
-    uso_info tmp_uso_info;
-    uso_read_header(file, header); //Must be first so offsets can be accurate
-    uso_read_symbol_table(file, header.import_sym_table_ofs, tmp_uso_info.import_syms);
-    uso_read_symbol_table(file, header.export_sym_table_ofs, tmp_uso_info.export_syms);
-    uso_list.push_back(tmp_uso_info);
-    fclose(file); //Close file
+    uso_cache_entry entry;
+    entry.hash = file_hash(file);
+    //Reuse symbols of unchanged USOs
+    std::unordered_map<std::string, uso_cache_entry>::iterator cached = uso_cache.find(path);
+    if (cached != uso_cache.end() && cached->second.hash == entry.hash) {
+        entry.info = cached->second.info;
+    } else {
+        uso_header_t header;
+        uso_read_header(file, header); //Must be first so offsets can be accurate
+        uso_read_symbol_table(file, header.import_sym_table_ofs, entry.info.import_syms);
+        uso_read_symbol_table(file, header.export_sym_table_ofs, entry.info.export_syms);
+        uso_cache_changed = true;
+    }
+    uso_list.push_back(entry.info);
+    uso_new_cache[path] = entry;
+    file_unmap(file);
     return true;
 }
 
-bool uso_sym_compare(const uso_symbol_info &first, const uso_symbol_info &second)
+void cache_write_symbols(std::ostringstream &out, char type, std::vector<uso_symbol_info> &list)
 {
-    //Compare names as strings
-    return first.name < second.name;
+    for (size_t i = 0; i < list.size(); i++) {
+        out << type << ' ' << list[i].name << '\n';
+    }
 }
 
-bool uso_sym_is_extern(size_t uso_id, std::string name)
+bool cache_write(const char *path)
 {
-    uso_symbol_info symbol = { name, 0, 0, false };
-    for (size_t i = 0; i < uso_list.size(); i++) {
-        //Skip this USO
-        if (i == uso_id) {
-            continue;
-        }
-        //Search for symbol
-        std::vector<uso_symbol_info>::iterator begin = uso_list[i].export_syms.begin();
-        std::vector<uso_symbol_info>::iterator end = uso_list[i].export_syms.end();
-        if (std::binary_search(begin, end, symbol, uso_sym_compare)) {
-            //Symbol is not extern if found in any export symbol table
-            return false;
-        }
+    //Cache is kept as is when no USO was added, removed, or changed
+    if (!uso_cache_changed && uso_new_cache.size() == uso_cache.size()) {
+        return true;
     }
-    //Symbol is extern if defined in no export symbol table
-    return true;
+    std::ostringstream out;
+    for (std::map<std::string, uso_cache_entry>::iterator it = uso_new_cache.begin(); it != uso_new_cache.end(); it++) {
+        char hash_str[17];
+        snprintf(hash_str, sizeof(hash_str), "%016llx", (unsigned long long)it->second.hash);
+        out << "U " << hash_str << ' ' << it->first << '\n';
+        cache_write_symbols(out, 'I', it->second.info.import_syms);
+        cache_write_symbols(out, 'E', it->second.info.export_syms);
+    }
+    return file_write_if_changed(path, out.str());
+}
+
+bool uso_sym_is_extern(const std::string &name)
+{
+    //USOs only import their own exports for vague linkage symbols so checking every USO's exports is enough
+    return uso_export_set.find(name) == uso_export_set.end();
 }
 
 void generate_uso_extern_list()
 {
+    //Collect exports of all USOs
+    for (size_t i = 0; i < uso_list.size(); i++) {
+        std::vector<uso_symbol_info> &export_sym_ref = uso_list[i].export_syms;
+        for (size_t j = 0; j < export_sym_ref.size(); j++) {
+            uso_export_set.insert(export_sym_ref[j].name);
+        }
+    }
     //Check all USOs
+    std::unordered_set<std::string> extern_set;
     for (size_t i = 0; i < uso_list.size(); i++) {
         //Check import symbols in each USO
         std::vector<uso_symbol_info> &import_sym_ref = uso_list[i].import_syms;
         for (size_t j = 0; j < import_sym_ref.size(); j++) {
-            //Add extern symbols to extern list
-            if (uso_sym_is_extern(i, import_sym_ref[j].name)) {
+            //Add extern symbols to extern list once
+            if (uso_sym_is_extern(import_sym_ref[j].name) && extern_set.insert(import_sym_ref[j].name).second) {
                 uso_extern_list.push_back(import_sym_ref[j].name);
             }
         }
     }
 }
 
-bool write_uso_extern_list(char *path)
+bool keep_list_read(const char *path)
 {
-    //Try to open output file
-    FILE *file = fopen(path, "w");
-    if (!file) {
-        std::cerr << "Failed to open " << path << " for writing." << std::endl;
+    std::vector<std::string> names;
+    if (!name_list_read(path, names)) {
+        std::cerr << "Failed to open " << path << " for reading." << std::endl;
         return false;
     }
+    uso_keep_export_set.insert(names.begin(), names.end());
+    return true;
+}
+
+void generate_uso_export_list()
+{
+    //Exports are kept if any USO imports them including USOs importing their own vague linkage symbols
+    for (size_t i = 0; i < uso_list.size(); i++) {
+        std::vector<uso_symbol_info> &import_sym_ref = uso_list[i].import_syms;
+        for (size_t j = 0; j < import_sym_ref.size(); j++) {
+            if (!uso_sym_is_extern(import_sym_ref[j].name)) {
+                uso_keep_export_set.insert(import_sym_ref[j].name);
+            }
+        }
+    }
+}
+
+bool write_uso_export_list(char *path)
+{
+    std::ostringstream out;
+    for (std::set<std::string>::iterator it = uso_keep_export_set.begin(); it != uso_keep_export_set.end(); ++it) {
+        out << *it << '\n';
+    }
+    return file_write_if_changed(path, out.str());
+}
+
+bool write_uso_extern_list(char *path)
+{
     //Print LD externs for every symbol
+    std::ostringstream out;
     for (size_t i = 0; i < uso_extern_list.size(); i++) {
-        fprintf(file, "EXTERN(%s)\n", uso_extern_list[i].c_str());
+        out << "EXTERN(" << uso_extern_list[i] << ")\n";
     }
-    fclose(file); //Close file
-    return true;
+    return file_write_if_changed(path, out.str());
+}
+
+bool write_uso_manifest(char *path, int num_usos, char **uso_paths)
+{
+    //Module IDs are assigned in the order of the USO list
+    std::ostringstream out;
+    for (int i = 0; i < num_usos; i++) {
+        out << uso_paths[i] << '\n';
+    }
+    return file_write_if_changed(path, out.str());
+}
+
+void print_usage(char *name)
+{
+    std::cout << "Usage: " << name << " [-m manifest] [-c cache] [-e export_list [-k keep_list]] output uso_list" << std::endl;
+    std::cout << "output is the destination of the result." << std::endl;
+    std::cout << "uso_list is a possibly empty space separated list of files." << std::endl;
+    std::cout << "manifest receives the module set for binding imports by ordinal in elf2uso." << std::endl;
+    std::cout << "export_list receives the USO exports imported by a USO or named in keep_list for elf2uso -e." << std::endl;
+    std::cout << "keep_list names exports looked up with uso_sym or by USOs outside uso_list (one per line)." << std::endl;
+    std::cout << "cache keeps the symbols of each USO so only changed USOs are read again." << std::endl;
+    std::cout << "output, manifest, and export_list are left untouched if their contents would not change." << std::endl;
 }
 
 int main(int argc, char **argv)
 {
-    if (argc < 2) {
-        std::cout << "Usage: " << argv[0] << " output uso_list" << std::endl;
-        std::cout << "output is the destination of the result." << std::endl;
-        std::cout << "uso_list is a possibly empty space separated list of files." << std::endl;
+    int arg_idx = 1;
+    char *manifest_path = NULL;
+    char *cache_path = NULL;
+    char *export_list_path = NULL;
+    //Parse options
+    while (arg_idx < argc && argv[arg_idx][0] == '-') {
+        std::string option = argv[arg_idx++];
+        if (option == "-m" && arg_idx < argc) {
+            manifest_path = argv[arg_idx++];
+        } else if (option == "-c" && arg_idx < argc) {
+            cache_path = argv[arg_idx++];
+        } else if (option == "-e" && arg_idx < argc) {
+            export_list_path = argv[arg_idx++];
+        } else if (option == "-k" && arg_idx < argc) {
+            if (!keep_list_read(argv[arg_idx++])) {
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - arg_idx < 1) {
+        print_usage(argv[0]);
         return 1;
     }
+    if (cache_path) {
+        cache_read(cache_path);
+    }
     //Read in USOs passed in on command line
-    for (int i = 2; i < argc; i++) {
+    for (int i = arg_idx + 1; i < argc; i++) {
         if (!uso_read(argv[i])) {
             return 1;
         }
@@ -240,7 +335,22 @@ int main(int argc, char **argv)
     //Generate extern list
     generate_uso_extern_list();
     //Write extern list
-    if (!write_uso_extern_list(argv[1])) {
+    if (!write_uso_extern_list(argv[arg_idx])) {
+        return 1;
+    }
+    //Write exports to keep
+    if (export_list_path) {
+        generate_uso_export_list();
+        if (!write_uso_export_list(export_list_path)) {
+            return 1;
+        }
+    }
+    //Write module set
+    if (manifest_path && !write_uso_manifest(manifest_path, argc - arg_idx - 1, &argv[arg_idx + 1])) {
+        return 1;
+    }
+    //Save symbols of USOs for next run
+    if (cache_path && !cache_write(cache_path)) {
         return 1;
     }
     return 0;
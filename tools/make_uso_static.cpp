@@ -0,0 +1,221 @@
+#define _CRT_SECURE_NO_WARNINGS //Shut up Visual Studio
+#include <stdio.h>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <elfio/elfio.hpp>
+
+//Kinds of sections merged by uso_static.ld with bounds for each module
+static const char *range_names[] = { "text", "rodata", "data", "bss" };
+
+struct static_module_info {
+    std::string name; //USO path relative to filesystem root
+    std::string id; //C identifier for generated symbols
+    std::vector<std::string> export_syms;
+};
+
+std::vector<static_module_info> module_list;
+
+std::string module_get_id(std::string name)
+{
+    //Replace characters not allowed in C identifiers
+    for (size_t i = 0; i < name.length(); i++) {
+        if (!isalnum((unsigned char)name[i])) {
+            name[i] = '_';
+        }
+    }
+    return name;
+}
+
+bool elf_valid(ELFIO::elfio &elf_reader)
+{
+    return elf_reader.get_class() == ELFIO::ELFCLASS32 //Check for 32-bit ELF
+        && elf_reader.get_encoding() == ELFIO::ELFDATA2MSB //Check for Big-Endian Platform
+        && elf_reader.get_machine() == ELFIO::EM_MIPS //Check for MIPS platform
+        && elf_reader.get_type() == ELFIO::ET_REL; //Check for relocatable ELF
+}
+
+bool module_read(std::string object_dir, std::string name)
+{
+    std::string path = object_dir + "/" + name + ".o";
+    ELFIO::elfio elf_reader;
+    if (!elf_reader.load_mapped(path)) {
+        std::cerr << "Failed to read " << path << "." << std::endl;
+        return false;
+    }
+    if (!elf_valid(elf_reader)) {
+        std::cerr << path << " is not a relocatable Nintendo 64 ELF file." << std::endl;
+        return false;
+    }
+    static_module_info module;
+    module.name = name;
+    module.id = module_get_id(name);
+    //Generated symbols of different USOs must not clash
+    for (size_t i = 0; i < module_list.size(); i++) {
+        if (module_list[i].id == module.id) {
+            std::cerr << name << " and " << module_list[i].name << " both map to identifier " << module.id << "." << std::endl;
+            return false;
+        }
+    }
+    for (ELFIO::Elf_Half i = 0; i < elf_reader.sections.size(); i++) {
+        if (elf_reader.sections[i]->get_type() != ELFIO::SHT_SYMTAB) {
+            continue;
+        }
+        ELFIO::symbol_section_accessor sym_accessor(elf_reader, elf_reader.sections[i]);
+        ELFIO::symbol_table syms;
+        sym_accessor.get_symbols(syms);
+        for (ELFIO::Elf_Xword j = 0; j < syms.size(); j++) {
+            //Hidden symbols were made local and special symbols were renamed to __uso_static_ symbols
+            if (syms.binds[j] == ELFIO::STB_LOCAL || syms.sections[j] == ELFIO::SHN_UNDEF || syms.others[j] != ELFIO::STV_DEFAULT) {
+                continue;
+            }
+            std::string_view sym_name = syms.names[j];
+            if (sym_name.empty() || sym_name.compare(0, 13, "__uso_static_") == 0) {
+                continue;
+            }
+            module.export_syms.push_back(std::string(sym_name));
+        }
+    }
+    //Sort exports for binary search at runtime
+    std::sort(module.export_syms.begin(), module.export_syms.end());
+    module.export_syms.erase(std::unique(module.export_syms.begin(), module.export_syms.end()), module.export_syms.end());
+    module_list.push_back(module);
+    return true;
+}
+
+void print_objcopy_flags(std::string name)
+{
+    std::string id = module_get_id(name);
+    //Constructor sections are renamed so the linker defines their bounds per USO
+    std::cout << "--rename-section .ctors=uso_ctors_" << id << " --rename-section .dtors=uso_dtors_" << id;
+    //Special symbols and section bounds defined by uso_static.ld are renamed per USO
+    std::cout << " --redefine-sym _prolog=__uso_static_" << id << "_prolog";
+    std::cout << " --redefine-sym _epilog=__uso_static_" << id << "_epilog";
+    std::cout << " --redefine-sym __dso_handle=__uso_static_" << id << "_dso_handle";
+    for (const char *range : range_names) {
+        std::cout << " --redefine-sym __uso_static_" << range << "_start=__uso_static_" << id << "_" << range << "_start";
+        std::cout << " --redefine-sym __uso_static_" << range << "_end=__uso_static_" << id << "_" << range << "_end";
+    }
+    std::cout << std::endl;
+}
+
+void write_module_externs(FILE *file, static_module_info &module)
+{
+    fprintf(file, "//%s\n", module.name.c_str());
+    //Reference exports by assembler name to support C++ names
+    for (size_t i = 0; i < module.export_syms.size(); i++) {
+        fprintf(file, "extern char __uso_static_%s_sym_%zu __asm__(\"%s\");\n", module.id.c_str(), i, module.export_syms[i].c_str());
+    }
+    //Constructor and destructor sections were renamed so the linker defines their bounds
+    fprintf(file, "extern void (*__start_uso_ctors_%s[])() __attribute__((weak));\n", module.id.c_str());
+    fprintf(file, "extern void (*__stop_uso_ctors_%s[])() __attribute__((weak));\n", module.id.c_str());
+    fprintf(file, "extern void (*__start_uso_dtors_%s[])() __attribute__((weak));\n", module.id.c_str());
+    fprintf(file, "extern void (*__stop_uso_dtors_%s[])() __attribute__((weak));\n", module.id.c_str());
+    //Section bounds are missing if the module has no section of that kind
+    for (const char *range : range_names) {
+        fprintf(file, "extern char __uso_static_%s_%s_start[] __attribute__((weak));\n", module.id.c_str(), range);
+        fprintf(file, "extern char __uso_static_%s_%s_end[] __attribute__((weak));\n", module.id.c_str(), range);
+    }
+    fprintf(file, "extern void __uso_static_%s_prolog() __attribute__((weak));\n", module.id.c_str());
+    fprintf(file, "extern void __uso_static_%s_epilog() __attribute__((weak));\n", module.id.c_str());
+    //Each module gets its own __dso_handle so atexit destructors can be run when closed
+    fprintf(file, "char __uso_static_%s_dso_handle;\n", module.id.c_str());
+    if (module.export_syms.size() != 0) {
+        fprintf(file, "static const uso_static_symbol_t %s_export_syms[] = {\n", module.id.c_str());
+        for (size_t i = 0; i < module.export_syms.size(); i++) {
+            fprintf(file, "\t{ \"%s\", &__uso_static_%s_sym_%zu },\n", module.export_syms[i].c_str(), module.id.c_str(), i);
+        }
+        fprintf(file, "};\n");
+    }
+    fprintf(file, "\n");
+}
+
+void write_module_info(FILE *file, static_module_info &module)
+{
+    const char *id = module.id.c_str();
+    fprintf(file, "\t{\n");
+    fprintf(file, "\t\t\"%s\",\n", module.name.c_str());
+    if (module.export_syms.size() != 0) {
+        fprintf(file, "\t\t%s_export_syms, %zu,\n", id, module.export_syms.size());
+    } else {
+        fprintf(file, "\t\tNULL, 0,\n");
+    }
+    fprintf(file, "\t\t__start_uso_ctors_%s, __stop_uso_ctors_%s,\n", id, id);
+    fprintf(file, "\t\t__start_uso_dtors_%s, __stop_uso_dtors_%s,\n", id, id);
+    fprintf(file, "\t\t__uso_static_%s_prolog, __uso_static_%s_epilog,\n", id, id);
+    fprintf(file, "\t\t&__uso_static_%s_dso_handle,\n", id);
+    fprintf(file, "\t\t{\n");
+    for (const char *range : range_names) {
+        fprintf(file, "\t\t\t{ __uso_static_%s_%s_start, __uso_static_%s_%s_end },\n", id, range, id, range);
+    }
+    fprintf(file, "\t\t}\n");
+    fprintf(file, "\t},\n");
+}
+
+bool write_registry(char *path)
+{
+    //Try to open output file
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        std::cerr << "Failed to open " << path << " for writing." << std::endl;
+        return false;
+    }
+    fprintf(file, "//Generated by make_uso_static\n");
+    fprintf(file, "#include <stddef.h>\n");
+    fprintf(file, "#include \"uso_static_internal.h\"\n\n");
+    for (size_t i = 0; i < module_list.size(); i++) {
+        write_module_externs(file, module_list[i]);
+    }
+    //C does not allow empty arrays
+    if (module_list.size() != 0) {
+        fprintf(file, "const uso_static_module_t __uso_static_modules[] = {\n");
+        for (size_t i = 0; i < module_list.size(); i++) {
+            write_module_info(file, module_list[i]);
+        }
+        fprintf(file, "};\n\n");
+    } else {
+        fprintf(file, "const uso_static_module_t __uso_static_modules[1];\n\n");
+    }
+    fprintf(file, "const uint32_t __uso_static_num_modules = %zu;\n", module_list.size());
+    fclose(file); //Close file
+    return true;
+}
+
+void print_usage(char *name)
+{
+    std::cout << "Usage: " << name << " output object_dir uso_list" << std::endl;
+    std::cout << "   or: " << name << " -f uso_name" << std::endl;
+    std::cout << "output is the destination of the generated C registry of modules." << std::endl;
+    std::cout << "uso_list is a possibly empty space separated list of USO names." << std::endl;
+    std::cout << "Each USO is read from object_dir as a relocatable ELF named after it with .o appended." << std::endl;
+    std::cout << "-f prints the objcopy flags renaming the special symbols of uso_name for the registry." << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    //Print flags so the Makefile uses the same identifiers as the registry
+    if (std::string(argv[1]) == "-f") {
+        if (argc != 3) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        print_objcopy_flags(argv[2]);
+        return 0;
+    }
+    //Read modules passed in on command line
+    for (int i = 3; i < argc; i++) {
+        if (!module_read(argv[2], argv[i])) {
+            return 1;
+        }
+    }
+    //Write registry
+    if (!write_registry(argv[1])) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+#ifndef TOOL_IO_H
+#define TOOL_IO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <ostream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//File helpers shared by the host tools
+
+//Whole file mapped for reading
+struct mapped_file {
+    const uint8_t *data;
+    size_t size;
+    std::vector<uint8_t> buffer; //Holds file contents when files can't be mapped
+};
+
+inline bool file_map(const char *path, mapped_file &file)
+{
+#ifdef _WIN32
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream.is_open()) {
+        return false;
+    }
+    file.buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    file.data = file.buffer.data();
+    file.size = file.buffer.size();
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    file.size = st.st_size;
+    file.data = NULL;
+    //Empty files can't be mapped
+    if (file.size != 0) {
+        void *ptr = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        file.data = (const uint8_t *)ptr;
+    }
+    close(fd); //Mapping stays valid after closing file
+    return true;
+#endif
+}
+
+inline void file_unmap(mapped_file &file)
+{
+#ifndef _WIN32
+    if (file.data) {
+        munmap((void *)file.data, file.size);
+    }
+#endif
+    file.data = NULL;
+    file.buffer.clear();
+}
+
+//Reads names listed one per line, skipping blank lines and # comments
+inline bool name_list_read(const char *path, std::vector<std::string> &names)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        //Strip carriage returns and surrounding whitespace
+        size_t start = line.find_first_not_of(" \t\r");
+        size_t end = line.find_last_not_of(" \t\r");
+        //Skip empty lines and comments
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+        names.push_back(line.substr(start, end - start + 1));
+    }
+    return true;
+}
+
+inline bool file_read(mapped_file &file, uint32_t ofs, void *dst, uint32_t size)
+{
+    if (ofs > file.size || size > file.size - ofs) {
+        return false;
+    }
+    memcpy(dst, file.data + ofs, size);
+    return true;
+}
+
+//Checks if the file at path already holds exactly data
+inline bool file_matches(const char *path, const void *data, size_t size)
+{
+    mapped_file file;
+    if (!file_map(path, file)) {
+        return false;
+    }
+    //Compare size first to avoid comparing files that changed size
+    bool match = file.size == size && (size == 0 || memcmp(file.data, data, size) == 0);
+    file_unmap(file);
+    return match;
+}
+
+//Writes data to path at once and reports errors to log
+//Path is left untouched when skip_identical is set and its contents would not change so dependents are not rebuilt
+inline bool file_write(const char *path, const void *data, size_t size, bool skip_identical, std::ostream &log)
+{
+    if (skip_identical && file_matches(path, data, size)) {
+        return true;
+    }
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        log << "Failed to open " << path << " for writing." << std::endl;
+        return false;
+    }
+    setvbuf(file, NULL, _IONBF, 0);
+    bool success = fwrite(data, 1, size, file) == size;
+    if (fclose(file) != 0 || !success) {
+        log << "Failed to write " << path << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif
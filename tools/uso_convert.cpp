@@ -0,0 +1,1587 @@
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include "uso_convert.h"
+#include "tool_io.h"
+
+//These symbols must not be undefined and used in the ELF
+std::vector<std::string> prohibited_import_symbols = {
+    //Special c library symbols
+    "__dso_handle",
+    "_init",
+    "_fini",
+    //Special functions for shared object start/end
+    "_prolog",
+    "_epilog"
+};
+
+//These symbols ignore visibility attributes
+std::vector<std::string> hideable_symbols = {
+    "__dso_handle",
+    //Special functions for shared object start/end
+    "_prolog",
+    "_epilog"
+};
+
+//Weak definitions with these prefixes are bound at load time to the first copy loaded so RTTI compares by pointer
+//Typeinfo, typeinfo names, and vtables
+std::vector<std::string> vague_linkage_prefixes = {
+    "_ZTI",
+    "_ZTS",
+    "_ZTV"
+};
+
+//Output sections for merging sections in the same order as uso.ld
+std::vector<section_rule> section_rules = {
+    { ".text", { ".text", ".text.*", ".init", ".fini", ".gnu.linkonce.t.*" } },
+    { ".eh_frame_hdr", { ".eh_frame_hdr" } },
+    { ".eh_frame", { ".eh_frame" } },
+    { ".gcc_except_table", { ".gcc_except_table*" } },
+    { ".rodata", { ".rdata", ".rodata", ".rodata.*", ".gnu.linkonce.r.*" } },
+    { ".ctors", { ".ctors" } },
+    { ".dtors", { ".dtors" } },
+    { ".data", { ".data", ".data.*", ".gnu.linkonce.d.*" } },
+    { ".sdata", { ".sdata", ".sdata.*", ".gnu.linkonce.s.*" } },
+    { ".lit8", { ".lit8" } },
+    { ".lit4", { ".lit4" } },
+    { ".sbss", { ".sbss", ".sbss.*", ".gnu.linkonce.sb.*", ".scommon", ".scommon.*" } },
+    { ".bss", { ".bss", ".bss*", ".gnu.linkonce.b.*" } }
+};
+
+void elf_index_sections(uso_context &ctx)
+{
+    //Earlier sections win when names are repeated
+    ctx.elf_reloc_sections.assign(ctx.elf_reader.sections.size(), ELFIO::SHN_UNDEF);
+    for (ELFIO::Elf_Half i = 1; i < ctx.elf_reader.sections.size(); i++) {
+        ELFIO::section *section = ctx.elf_reader.sections[i];
+        ctx.elf_section_index.insert(std::make_pair(section->get_name(), i));
+        //Relocation sections name the section they apply to in their info field
+        if (section->get_type() == ELFIO::SHT_REL && section->get_info() < ctx.elf_reloc_sections.size()) {
+            ctx.elf_reloc_sections[section->get_info()] = i;
+        }
+    }
+}
+
+ELFIO::Elf_Half elf_find_section(uso_context &ctx, std::string name)
+{
+    std::unordered_map<std::string, ELFIO::Elf_Half>::iterator section = ctx.elf_section_index.find(name);
+    if (section != ctx.elf_section_index.end()) {
+        //Found section name in list of sections
+        return section->second;
+    }
+    //ELFIO::SHN_UNDEF is never a valid section index
+    return ELFIO::SHN_UNDEF;
+}
+
+const ELFIO::relocation_table &elf_get_relocs(uso_context &ctx, ELFIO::Elf_Half index)
+{
+    static const ELFIO::relocation_table no_relocs;
+    //Relocations only apply to real sections
+    if (index == ELFIO::SHN_UNDEF || index >= ctx.elf_relocs.size()) {
+        return no_relocs;
+    }
+    return ctx.elf_relocs[index];
+}
+
+void elf_read_tables(uso_context &ctx)
+{
+    //Whole tables are decoded at once as they are walked many times
+    ELFIO::symbol_section_accessor sym_accessor(ctx.elf_reader, ctx.elf_reader.sections[ctx.elf_symbol_sec_index]);
+    sym_accessor.get_symbols(ctx.elf_syms);
+    ctx.elf_relocs.resize(ctx.elf_reloc_sections.size());
+    for (size_t i = 0; i < ctx.elf_reloc_sections.size(); i++) {
+        if (ctx.elf_reloc_sections[i] != ELFIO::SHN_UNDEF) {
+            ELFIO::relocation_section_accessor reloc_accessor(ctx.elf_reader, ctx.elf_reader.sections[ctx.elf_reloc_sections[i]]);
+            reloc_accessor.get_entries(ctx.elf_relocs[i]);
+        }
+    }
+}
+
+uint16_t section_get_out_index(uso_context &ctx, ELFIO::Elf_Half index)
+{
+    //Special section indices are never output
+    if (index >= ctx.out_section_map.size()) {
+        return 0;
+    }
+    return ctx.out_section_map[index];
+}
+
+uint32_t section_get_out_base(uso_context &ctx, ELFIO::Elf_Half index)
+{
+    if (index >= ctx.out_section_base.size()) {
+        return 0;
+    }
+    return ctx.out_section_base[index];
+}
+
+bool elf_valid(uso_context &ctx)
+{
+    //Check if symbol table can be found
+    ctx.elf_symbol_sec_index = elf_find_section(ctx, ".symtab");
+    if (ctx.elf_symbol_sec_index == ELFIO::SHN_UNDEF) {
+        ctx.log << "ELF file is missing symbol table." << std::endl;
+        return false;
+    }
+    return ctx.elf_reader.get_class() == ELFIO::ELFCLASS32 //Check for 32-bit ELF
+        && ctx.elf_reader.get_encoding() == ELFIO::ELFDATA2MSB //Check for Big-Endian Platform
+        && ctx.elf_reader.get_machine() == ELFIO::EM_MIPS //Check for MIPS platform
+        && ctx.elf_reader.get_type() == ELFIO::ET_REL; //Check for relocatable ELF
+}
+
+bool elf_has_global_constructors(uso_context &ctx)
+{
+	ELFIO::Elf_Half ctor_section = elf_find_section(ctx, ".ctors");
+	//ELF has constructors if .ctors section exists and has non-zero size
+	if(ctor_section != ELFIO::SHN_UNDEF && ctx.elf_reader.sections[ctor_section]->get_size() > 0) {
+		return true;
+	}
+	return false;
+}
+
+bool sym_compare(symbol_info &first, symbol_info &second)
+{
+    //Compare names as strings
+    return first.name < second.name;
+}
+
+bool import_sym_compare(symbol_info &first, symbol_info &second)
+{
+    //Imports bound by ordinal come first as their names are not written
+    bool first_ordinal = first.section != 0;
+    bool second_ordinal = second.section != 0;
+    if (first_ordinal != second_ordinal) {
+        return first_ordinal;
+    }
+    return first.name < second.name;
+}
+
+void sym_bind_ordinals(uso_context &ctx)
+{
+    for (size_t i = 0; i < ctx.import_syms.size(); i++) {
+        //Vague linkage imports are bound by name to whichever copy is loaded first
+        if (ctx.elf_syms.sections[ctx.import_syms[i].src_symbol] != ELFIO::SHN_UNDEF) {
+            continue;
+        }
+        //Bind to first module in set exporting symbol
+        for (size_t j = 0; j < ctx.options.module_set.size(); j++) {
+            if (j + 1 == ctx.module_id) {
+                continue;
+            }
+            const std::vector<std::string> &names = ctx.options.module_set[j].export_names;
+            std::vector<std::string>::const_iterator name = std::lower_bound(names.begin(), names.end(), ctx.import_syms[i].name);
+            if (name != names.end() && *name == ctx.import_syms[i].name) {
+                ctx.import_syms[i].section = j + 1;
+                ctx.import_syms[i].addr = name - names.begin();
+                break;
+            }
+        }
+    }
+}
+
+void sym_sort(uso_context &ctx)
+{
+    //Sort import and export symbol tables
+    std::sort(ctx.import_syms.begin(), ctx.import_syms.end(), import_sym_compare);
+    std::sort(ctx.export_syms.begin(), ctx.export_syms.end(), sym_compare);
+}
+
+bool sym_is_prohibited_import(std::string name)
+{
+    return std::find(prohibited_import_symbols.begin(), prohibited_import_symbols.end(), name) != prohibited_import_symbols.end();
+}
+
+bool sym_is_hideable(std::string name)
+{
+    return std::find(hideable_symbols.begin(), hideable_symbols.end(), name) != hideable_symbols.end();
+}
+
+bool sym_reverse_name_compare(const std::string &first, const std::string &second)
+{
+    //Compare names from last character to first
+    return std::lexicographical_compare(first.rbegin(), first.rend(), second.rbegin(), second.rend());
+}
+
+bool sym_name_is_suffix(const std::string &suffix, const std::string &name)
+{
+    return suffix.length() <= name.length() && std::equal(suffix.rbegin(), suffix.rend(), name.rbegin());
+}
+
+void sym_build_name_pool(std::vector<symbol_info> &syms, std::string &pool, std::map<std::string, uint32_t> &name_ofs_map)
+{
+    //Sort unique names by reversed name so names that are suffixes of another name come right before it
+    std::vector<std::string> names;
+    for (size_t i = 0; i < syms.size(); i++) {
+        names.push_back(syms[i].name);
+    }
+    std::sort(names.begin(), names.end(), sym_reverse_name_compare);
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    //Place names from longest suffix chain end backwards
+    for (size_t i = names.size(); i-- > 0;) {
+        if (i + 1 < names.size() && sym_name_is_suffix(names[i], names[i + 1])) {
+            //Share tail and NULL terminator of next name
+            name_ofs_map[names[i]] = name_ofs_map[names[i + 1]] + names[i + 1].length() - names[i].length();
+        } else {
+            //Write name with NULL terminator
+            name_ofs_map[names[i]] = pool.length();
+            pool += names[i];
+            pool += '\0';
+        }
+    }
+}
+
+uint32_t sym_get_data_size(std::vector<symbol_info> &syms)
+{
+    std::string pool;
+    std::map<std::string, uint32_t> name_ofs_map;
+    sym_build_name_pool(syms, pool, name_ofs_map);
+    //Symbol table size with merged names
+    return 4 + (sizeof(uso_symbol_t) * syms.size()) + pool.length();
+}
+
+bool sym_is_pruned_export(const uso_options &options, const std::string &name)
+{
+    return options.prune_exports && !sym_is_hideable(name) && options.export_keep_set.find(name) == options.export_keep_set.end();
+}
+
+bool sym_is_vague_linkage(uso_context &ctx, ELFIO::Elf_Xword index)
+{
+    if (ctx.elf_syms.binds[index] != ELFIO::STB_WEAK || ctx.elf_syms.sections[index] == ELFIO::SHN_UNDEF) {
+        return false;
+    }
+    std::string name(ctx.elf_syms.names[index]);
+    for (size_t i = 0; i < vague_linkage_prefixes.size(); i++) {
+        if (name.compare(0, vague_linkage_prefixes[i].length(), vague_linkage_prefixes[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void sym_collect(uso_context &ctx)
+{
+    for (ELFIO::Elf_Xword i = 0; i < ctx.elf_syms.size(); i++) {
+        //Skip local symbols
+        if (ctx.elf_syms.binds[i] == ELFIO::STB_LOCAL) {
+            continue;
+        }
+        //Symbol temporaries
+        std::string name(ctx.elf_syms.names[i]);
+        ELFIO::Elf64_Addr value = ctx.elf_syms.values[i];
+        unsigned char type = ctx.elf_syms.types[i];
+        ELFIO::Elf_Half section_index = ctx.elf_syms.sections[i];
+        unsigned char other = ctx.elf_syms.others[i];
+        //Reject symbol names longer than 32767 characters
+        if (name.length() >= 32767) {
+            ctx.log << "Symbol ID " << i << " has too long of a name" << std::endl;
+            throw uso_error();
+        }
+        if (section_index == ELFIO::SHN_UNDEF) {
+            //Symbols only used by removed sections are not imported
+            if (ctx.options.gc_sections && !ctx.sym_referenced[i]) {
+                continue;
+            }
+            if (sym_is_prohibited_import(name)) {
+                ctx.log << "Disallowed import symbol " << name << "." << std::endl;
+                throw uso_error();
+            }
+            //Main binary symbols are bound at build time and not imported
+            std::map<std::string, uint32_t>::const_iterator global_sym = ctx.options.global_sym_map.find(name);
+            if (global_sym != ctx.options.global_sym_map.end()) {
+                ctx.prebound_sym_map[i] = global_sym->second;
+                continue;
+            }
+            symbol_info symbol;
+            //Populate import symbol
+            symbol.src_symbol = i;
+            symbol.name = name;
+            symbol.section = 0; //Import symbols have no section
+            symbol.weak = type == ELFIO::STB_WEAK; //Set weak flag
+            symbol.addr = value;
+            ctx.import_syms.push_back(symbol); //Add import symbol
+        } else {
+            //Only add symbols with default visibility for export but also include always exported symbols
+            if (sym_is_hideable(name) || other == ELFIO::STV_DEFAULT) {
+                symbol_info symbol;
+                //Populate export symbol
+                symbol.src_symbol = i;
+                symbol.name = name;
+                symbol.addr = value;
+                symbol.section = section_get_out_index(ctx, section_index); //Lookup section index in map
+                if (sym_is_pruned_export(ctx.options, name)) {
+                    ctx.pruned_export_syms.push_back(symbol);
+                    continue;
+                }
+                if (sym_is_vague_linkage(ctx, i)) {
+                    std::map<std::string, uint32_t>::const_iterator global_sym = ctx.options.global_sym_map.find(name);
+                    if (global_sym != ctx.options.global_sym_map.end()) {
+                        //Copies in the main binary are used instead of this one
+                        //Export stays as an absolute symbol so export tables match USOs built without global_syms
+                        ctx.prebound_sym_map[i] = global_sym->second;
+                        symbol.section = 0;
+                        symbol.addr = global_sym->second;
+                        symbol.weak = false;
+                        ctx.export_syms.push_back(symbol);
+                        continue;
+                    }
+                    //References go through an import of the same name that falls back to this copy
+                    symbol_info import_symbol = symbol;
+                    import_symbol.section = 0;
+                    import_symbol.weak = false;
+                    import_symbol.addr = 0;
+                    ctx.import_syms.push_back(import_symbol);
+                }
+                if (symbol.section == 0) {
+                    //Fallback to section 0 if section index cannot be found
+                    //Check for absolute symbol that will point to NULL
+                    if (value == 0) {
+                        ctx.log << "NULL absolute symbols disallowed." << std::endl;
+                        throw uso_error();
+                    }
+                } else {
+                    symbol.addr += ctx.out_section_base[section_index]; //Make address relative to merged section
+                }
+
+                symbol.weak = false; //Export symbols are never weak
+                ctx.export_syms.push_back(symbol);
+            }
+        }
+    }
+    if (!ctx.pruned_export_syms.empty()) {
+        //Report table bytes saved with names merged as they are written
+        std::vector<symbol_info> all_syms = ctx.export_syms;
+        all_syms.insert(all_syms.end(), ctx.pruned_export_syms.begin(), ctx.pruned_export_syms.end());
+        ctx.log << "Pruned " << ctx.pruned_export_syms.size() << " of " << all_syms.size() << " exports saving ";
+        ctx.log << sym_get_data_size(all_syms) - sym_get_data_size(ctx.export_syms) << " bytes." << std::endl;
+    }
+    if (ctx.export_syms.size() == 0 && ctx.pruned_export_syms.empty() && !elf_has_global_constructors(ctx)) {
+        //Warn about no external symbols for ELF
+        ctx.log << "No exported symbols or global constructors in input ELF." << std::endl;
+        ctx.log << "Exported symbols are defined, are non-local, and have default visibility." << std::endl;
+        ctx.log << "Certain symbols can have non-default visibility as well." << std::endl;
+        ctx.log << "These symbols are known as hideable symbols." << std::endl;
+        ctx.log << "Hideable Symbols: ";
+        for (size_t i = 0; i < hideable_symbols.size(); i++) {
+            ctx.log << hideable_symbols[i];
+            ctx.log << " ";
+        }
+        ctx.log << std::endl;
+    }
+    //Bind imports before sorting as ordinal imports are sorted first
+    sym_bind_ordinals(ctx);
+    //Sort symbols here for correct import symbol to elf symbol mapping and runtime optimizations
+    sym_sort(ctx);
+    //Generate mapping for import symbols
+    for (size_t i = 0; i < ctx.import_syms.size(); i++) {
+        ctx.import_sym_map[ctx.import_syms[i].src_symbol] = i;
+    }
+}
+
+uint32_t reloc_read_u32(std::vector<char> &data, uint32_t offset)
+{
+    uint8_t *ptr = (uint8_t *)&data[offset];
+    return (ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
+}
+
+void reloc_write_u32(std::vector<char> &data, uint32_t offset, uint32_t value)
+{
+    uint8_t *ptr = (uint8_t *)&data[offset];
+    ptr[0] = value >> 24;
+    ptr[1] = value >> 16;
+    ptr[2] = value >> 8;
+    ptr[3] = value;
+}
+
+bool section_name_matches(const std::string &name, const std::string &pattern)
+{
+    if (!pattern.empty() && pattern[pattern.length() - 1] == '*') {
+        //Match prefix before wildcard
+        return name.compare(0, pattern.length() - 1, pattern, 0, pattern.length() - 1) == 0;
+    }
+    return name == pattern;
+}
+
+size_t section_find_rule(const std::string &name)
+{
+    for (size_t i = 0; i < section_rules.size(); i++) {
+        for (size_t j = 0; j < section_rules[i].patterns.size(); j++) {
+            if (section_name_matches(name, section_rules[i].patterns[j])) {
+                return i;
+            }
+        }
+    }
+    //Section is not merged with any other section
+    return section_rules.size();
+}
+
+bool section_is_live(uso_context &ctx, ELFIO::Elf_Half index)
+{
+    return !ctx.options.gc_sections || ctx.section_live[index];
+}
+
+bool eh_frame_record_compare(uint32_t offset, const eh_frame_record &record)
+{
+    return offset < record.offset;
+}
+
+void gc_mark_section(uso_context &ctx, ELFIO::Elf_Half index, std::vector<ELFIO::Elf_Half> &worklist)
+{
+    //Absolute and other special section indices are never marked
+    if (index != ELFIO::SHN_UNDEF && index < ctx.elf_reader.sections.size() && !ctx.section_live[index]) {
+        ctx.section_live[index] = true;
+        worklist.push_back(index);
+    }
+}
+
+void gc_mark_reloc(uso_context &ctx, const ELFIO::relocation_table &relocs, ELFIO::Elf_Xword index, std::vector<ELFIO::Elf_Half> &worklist)
+{
+    ELFIO::Elf_Word symbol = relocs.symbols[index];
+    ELFIO::Elf_Half sym_section = ctx.elf_syms.sections[symbol];
+    if (sym_section == ELFIO::SHN_UNDEF) {
+        ctx.sym_referenced[symbol] = true;
+    } else {
+        gc_mark_section(ctx, sym_section, worklist);
+    }
+}
+
+void gc_mark_eh_frame_record(uso_context &ctx, eh_frame_record &record, const ELFIO::relocation_table &relocs, std::vector<ELFIO::Elf_Half> &worklist)
+{
+    record.live = true;
+    //Mark personality routines and language-specific data used by record
+    for (size_t i = 0; i < record.relocs.size(); i++) {
+        gc_mark_reloc(ctx, relocs, record.relocs[i], worklist);
+    }
+}
+
+void gc_read_eh_frame(uso_context &ctx)
+{
+    ctx.eh_frame_elf_section = elf_find_section(ctx, ".eh_frame");
+    if (ctx.eh_frame_elf_section == ELFIO::SHN_UNDEF || ctx.elf_reader.sections[ctx.eh_frame_elf_section]->get_type() == ELFIO::SHT_NOBITS) {
+        ctx.eh_frame_elf_section = ELFIO::SHN_UNDEF;
+        return;
+    }
+    ELFIO::section *section = ctx.elf_reader.sections[ctx.eh_frame_elf_section];
+    std::vector<char> data(section->get_data(), section->get_data() + section->get_size());
+    //Split section into CIEs and FDEs until terminator
+    uint32_t offset = 0;
+    while (offset + 4 <= data.size()) {
+        uint32_t length = reloc_read_u32(data, offset);
+        if (length == 0) {
+            break;
+        }
+        //64-bit records are not used on MIPS
+        if (length < 8 || length == 0xFFFFFFFF || length > data.size() - offset - 4) {
+            ctx.log << "Invalid .eh_frame record at offset " << offset << "." << std::endl;
+            throw uso_error();
+        }
+        eh_frame_record record;
+        record.offset = offset;
+        record.size = length + 4;
+        //CIE pointer is zero for CIEs and relative to itself for FDEs
+        uint32_t cie_pointer = reloc_read_u32(data, offset + 4);
+        record.cie_offset = (cie_pointer == 0) ? offset : offset + 4 - cie_pointer;
+        record.pc_section = ELFIO::SHN_UNDEF;
+        record.live = false;
+        ctx.eh_frame_records.push_back(record);
+        offset += record.size;
+    }
+    //Assign relocations to records
+    const ELFIO::relocation_table &relocs = elf_get_relocs(ctx, ctx.eh_frame_elf_section);
+    ctx.eh_frame_dead_relocs.assign(relocs.size(), false);
+    for (ELFIO::Elf_Xword i = 0; i < relocs.size(); i++) {
+        ELFIO::Elf64_Addr offset = relocs.offsets[i];
+        std::vector<eh_frame_record>::iterator record = std::upper_bound(ctx.eh_frame_records.begin(), ctx.eh_frame_records.end(), (uint32_t)offset, eh_frame_record_compare);
+        if (record == ctx.eh_frame_records.begin()) {
+            continue;
+        }
+        --record;
+        if (offset >= record->offset + record->size) {
+            continue;
+        }
+        record->relocs.push_back(i);
+        //Function start of FDE follows CIE pointer
+        if (record->cie_offset != record->offset && offset == record->offset + 8) {
+            record->pc_section = ctx.elf_syms.sections[relocs.symbols[i]];
+        }
+    }
+}
+
+void gc_mark_sections(uso_context &ctx)
+{
+    ctx.section_live.assign(ctx.elf_reader.sections.size(), false);
+    ctx.sym_referenced.assign(ctx.elf_syms.size(), false);
+    gc_read_eh_frame(ctx);
+    std::vector<ELFIO::Elf_Half> worklist;
+    //Sections defining exported symbols are always kept unless the export is pruned
+    for (ELFIO::Elf_Xword i = 0; i < ctx.elf_syms.size(); i++) {
+        ELFIO::Elf_Half section = ctx.elf_syms.sections[i];
+        std::string name(ctx.elf_syms.names[i]);
+        if (ctx.elf_syms.binds[i] != ELFIO::STB_LOCAL && section != ELFIO::SHN_UNDEF && (ctx.elf_syms.others[i] == ELFIO::STV_DEFAULT || sym_is_hideable(name)) && !sym_is_pruned_export(ctx.options, name)) {
+            gc_mark_section(ctx, section, worklist);
+        }
+    }
+    //Constructors and destructors are always run
+    gc_mark_section(ctx, elf_find_section(ctx, ".ctors"), worklist);
+    gc_mark_section(ctx, elf_find_section(ctx, ".dtors"), worklist);
+    //Exception frames are kept but only mark sections through records of kept functions
+    const ELFIO::relocation_table &eh_frame_relocs = elf_get_relocs(ctx, ctx.eh_frame_elf_section);
+    if (ctx.eh_frame_elf_section != ELFIO::SHN_UNDEF) {
+        ctx.section_live[ctx.eh_frame_elf_section] = true;
+    }
+    do {
+        //Mark sections referenced by kept sections
+        while (!worklist.empty()) {
+            ELFIO::Elf_Half index = worklist.back();
+            worklist.pop_back();
+            const ELFIO::relocation_table &relocs = elf_get_relocs(ctx, index);
+            for (ELFIO::Elf_Xword i = 0; i < relocs.size(); i++) {
+                gc_mark_reloc(ctx, relocs, i, worklist);
+            }
+        }
+        if (eh_frame_relocs.size() == 0) {
+            break;
+        }
+        //Keep FDEs of kept functions along with their CIEs
+        for (size_t i = 0; i < ctx.eh_frame_records.size(); i++) {
+            eh_frame_record &record = ctx.eh_frame_records[i];
+            if (record.live || record.cie_offset == record.offset) {
+                continue;
+            }
+            if (record.pc_section == ELFIO::SHN_UNDEF || record.pc_section >= ctx.section_live.size() || ctx.section_live[record.pc_section]) {
+                gc_mark_eh_frame_record(ctx, record, eh_frame_relocs, worklist);
+                std::vector<eh_frame_record>::iterator cie = std::upper_bound(ctx.eh_frame_records.begin(), ctx.eh_frame_records.end(), record.cie_offset, eh_frame_record_compare);
+                if (cie != ctx.eh_frame_records.begin() && (cie - 1)->offset == record.cie_offset && !(cie - 1)->live) {
+                    gc_mark_eh_frame_record(ctx, *(cie - 1), eh_frame_relocs, worklist);
+                }
+            }
+        }
+    } while (!worklist.empty());
+    //Relocations of records for removed functions are dropped
+    for (size_t i = 0; i < ctx.eh_frame_records.size(); i++) {
+        if (!ctx.eh_frame_records[i].live) {
+            for (size_t j = 0; j < ctx.eh_frame_records[i].relocs.size(); j++) {
+                ctx.eh_frame_dead_relocs[ctx.eh_frame_records[i].relocs[j]] = true;
+            }
+        }
+    }
+}
+
+void section_collect(uso_context &ctx)
+{
+    section_info section_data;
+    //Push absolute fallback section
+    section_data.has_data = false;
+    section_data.writable = false;
+    section_data.size = 0;
+    section_data.align = 0;
+    ctx.out_section_map.assign(ctx.elf_reader.sections.size(), 0);
+    ctx.out_section_base.assign(ctx.elf_reader.sections.size(), 0);
+    ctx.out_sections.push_back(section_data);
+    //Group kept sections by output section in output order
+    std::map<size_t, std::vector<ELFIO::Elf_Half> > section_groups;
+    for (ELFIO::Elf_Half i = 1; i < ctx.elf_reader.sections.size(); i++) {
+        ELFIO::Elf_Xword flags = ctx.elf_reader.sections[i]->get_flags();
+        if ((flags & ELFIO::SHF_ALLOC) && section_is_live(ctx, i)) {
+            size_t order = i;
+            if (ctx.options.merge_sections) {
+                //Sections left unmerged by the linker are merged like uso.ld with other sections placed after
+                order = section_find_rule(ctx.elf_reader.sections[i]->get_name());
+                if (order == section_rules.size()) {
+                    order += i;
+                }
+            }
+            section_groups[order].push_back(i);
+        }
+    }
+    for (std::map<size_t, std::vector<ELFIO::Elf_Half> >::iterator group = section_groups.begin(); group != section_groups.end(); group++) {
+        section_data.elf_sections = group->second;
+        section_data.has_data = false;
+        section_data.writable = false;
+        section_data.data.clear();
+        section_data.size = 0;
+        section_data.align = 0;
+        //SHT_NOBITS sections have no relocation data or data unless merged with sections that do
+        for (size_t i = 0; i < group->second.size(); i++) {
+            if (ctx.elf_reader.sections[group->second[i]]->get_type() != ELFIO::SHT_NOBITS) {
+                section_data.has_data = true;
+            }
+            if (ctx.elf_reader.sections[group->second[i]]->get_flags() & ELFIO::SHF_WRITE) {
+                section_data.writable = true;
+            }
+        }
+        for (size_t i = 0; i < group->second.size(); i++) {
+            ELFIO::section *section = ctx.elf_reader.sections[group->second[i]];
+            //Place input section at next aligned offset
+            uint32_t base = section_data.size;
+            size_t align = section->get_addr_align();
+            if (align > 1) {
+                base = (base + align - 1) & ~(align - 1);
+            }
+            if (align > section_data.align) {
+                section_data.align = align;
+            }
+            section_data.size = base + section->get_size();
+            if (section_data.has_data) {
+                //Copy data so relocations can be applied at build time
+                section_data.data.resize(base, 0);
+                if (section->get_type() == ELFIO::SHT_NOBITS) {
+                    section_data.data.resize(section_data.size, 0);
+                } else {
+                    section_data.data.insert(section_data.data.end(), section->get_data(), section->get_data() + section->get_size());
+                }
+            }
+            if (group->second[i] == ctx.eh_frame_elf_section) {
+                //Clear function start of FDEs for removed functions so they are never matched
+                for (size_t j = 0; j < ctx.eh_frame_records.size(); j++) {
+                    if (!ctx.eh_frame_records[j].live && ctx.eh_frame_records[j].cie_offset != ctx.eh_frame_records[j].offset) {
+                        reloc_write_u32(section_data.data, base + ctx.eh_frame_records[j].offset + 8, 0);
+                    }
+                }
+            }
+            //Add section
+            ctx.out_section_map[group->second[i]] = ctx.out_sections.size();
+            ctx.out_section_base[group->second[i]] = base;
+        }
+        ctx.out_sections.push_back(section_data);
+    }
+}
+
+void reloc_apply_prebound(uso_context &ctx, const ELFIO::relocation_table &relocs, ELFIO::Elf_Xword index, section_info &section, uint32_t base, uint32_t sym_addr)
+{
+    ELFIO::Elf64_Addr offset = relocs.offsets[index] + base;
+    ELFIO::Elf_Word symbol = relocs.symbols[index];
+    unsigned int type = relocs.types[index];
+    if (offset + 4 > section.size) {
+        ctx.log << "Relocation offset " << offset << " is outside section." << std::endl;
+        throw uso_error();
+    }
+    uint32_t value = reloc_read_u32(section.data, offset);
+    //Apply relocations the same way as the runtime linker
+    switch (type) {
+        case 2: //R_MIPS_32
+            value += sym_addr;
+            break;
+
+        case 4: //R_MIPS_26
+        {
+            uint32_t target_addr = ((value & 0x3FFFFFF) << 2) + sym_addr;
+            value = (value & 0xFC000000) | ((target_addr & 0xFFFFFFC) >> 2);
+        }
+        break;
+
+        case 5: //R_MIPS_HI16
+        {
+            uint32_t addr = (value & 0xFFFF) << 16;
+            //Find paired R_MIPS_LO16 for same symbol to calculate carry
+            for (ELFIO::Elf_Xword i = index + 1; i < relocs.size(); i++) {
+                if (relocs.types[i] == 6 && relocs.symbols[i] == symbol) {
+                    //Add sign-extended lo to address
+                    addr += (int16_t)(reloc_read_u32(section.data, base + relocs.offsets[i]) & 0xFFFF);
+                    break;
+                }
+            }
+            addr += sym_addr;
+            //Adjust hi so sign-extended lo produces the correct address
+            value = (value & 0xFFFF0000) | (((addr + 0x8000) >> 16) & 0xFFFF);
+        }
+        break;
+
+        case 6: //R_MIPS_LO16
+            value = (value & 0xFFFF0000) | ((value + sym_addr) & 0xFFFF);
+            break;
+
+        case 7: //R_MIPS_GPREL16
+        {
+            //Symbol must be within reach of GP such as in small data of main binary
+            int64_t gp_offset = (int64_t)(int16_t)(value & 0xFFFF) + sym_addr - ctx.options.global_gp;
+            if (ctx.options.global_gp == 0 || gp_offset < -0x8000 || gp_offset > 0x7FFF) {
+                ctx.log << "GP-relative reference to " << ctx.elf_syms.names[symbol] << " which is not in small data of main binary." << std::endl;
+                throw uso_error();
+            }
+            value = (value & 0xFFFF0000) | (gp_offset & 0xFFFF);
+        }
+        break;
+
+        default:
+            ctx.log << "Invalid relocation type " << type << " for symbol bound at build time." << std::endl;
+            throw uso_error();
+            break;
+    }
+    reloc_write_u32(section.data, offset, value);
+    ctx.num_prebound_relocs++;
+}
+
+void reloc_build(uso_context &ctx)
+{
+    //Loop through input sections of output sections with attached relocation sections
+    for (size_t i = 0; i < ctx.out_sections.size(); i++) {
+        for (size_t k = 0; k < ctx.out_sections[i].elf_sections.size(); k++) {
+            ELFIO::Elf_Half elf_section = ctx.out_sections[i].elf_sections[k];
+            //SHT_NOBITS sections have no relocation data
+            if (ctx.elf_reader.sections[elf_section]->get_type() == ELFIO::SHT_NOBITS) {
+                continue;
+            }
+            //Find relocation section applied to input section if one exists
+            const ELFIO::relocation_table &relocs = elf_get_relocs(ctx, elf_section);
+            uint32_t base = ctx.out_section_base[elf_section];
+            for (ELFIO::Elf_Xword j = 0; j < relocs.size(); j++) {
+                //Skip relocations of exception frames for removed functions
+                if (elf_section == ctx.eh_frame_elf_section && !ctx.eh_frame_dead_relocs.empty() && ctx.eh_frame_dead_relocs[j]) {
+                    continue;
+                }
+                uso_reloc_t reloc_tmp;
+                ELFIO::Elf_Word symbol = relocs.symbols[j];
+                //Write known fields
+                reloc_tmp.offset = base + relocs.offsets[j];
+                reloc_tmp.info = (relocs.types[j] << 26);
+                {
+                    //Read symbol relocation is accessing
+                    ELFIO::Elf64_Addr sym_value = ctx.elf_syms.values[symbol];
+                    ELFIO::Elf_Half sym_section = ctx.elf_syms.sections[symbol];
+                    if (ctx.prebound_sym_map.find(symbol) != ctx.prebound_sym_map.end()) {
+                        //Relocation references main binary symbol
+                        reloc_apply_prebound(ctx, relocs, j, ctx.out_sections[i], base, ctx.prebound_sym_map[symbol]);
+                    } else if (relocs.types[j] == 7 && (sym_section != ELFIO::SHN_UNDEF || ctx.options.global_fingerprint != 0)) {
+                        //Only main binary symbols can be reached from GP and those are bound with global_syms when given
+                        ctx.log << "GP-relative reference to " << ctx.elf_syms.names[symbol] << " which is not in main binary." << std::endl;
+                        ctx.log << "Compile with -G 0 so data of the USO itself is not accessed through GP." << std::endl;
+                        throw uso_error();
+                    } else if (sym_section == ELFIO::SHN_UNDEF || ctx.import_sym_map.find(symbol) != ctx.import_sym_map.end()) {
+                        //Relocation references undefined or vague linkage symbol
+                        reloc_tmp.info |= ctx.import_sym_map[symbol] & 0x3FFFFFF; //Write import symbol ID
+                        reloc_tmp.sym_offset = 0; //Assume 0 symbol offset for these symbols
+                        ctx.out_sections[i].external_relocs.push_back(reloc_tmp); //Write external relocation
+                    } else {
+                        reloc_tmp.info |= section_get_out_index(ctx, sym_section) & 0x3FFFFFF; //Write section ID
+                        reloc_tmp.sym_offset = sym_value + section_get_out_base(ctx, sym_section); //Use address relative to merged section as symbol offset
+                        ctx.out_sections[i].internal_relocs.push_back(reloc_tmp); //Write internal relocation
+                    }
+                }
+            }
+        }
+    }
+}
+
+void eh_frame_skip_leb128(std::vector<char> &data, uint32_t &offset, uint32_t end)
+{
+    //Signed and unsigned LEB128 values have the same length
+    while (offset < end && (data[offset++] & 0x80)) {
+    }
+}
+
+bool eh_frame_read_fde_encoding(std::vector<char> &data, uint32_t offset, uint32_t end, uint8_t &encoding)
+{
+    //Walk CIE to augmentation data holding encoding of FDE function starts
+    uint32_t pos = offset + 8;
+    if (pos >= end) {
+        return false;
+    }
+    uint8_t version = data[pos++];
+    std::string augmentation;
+    while (pos < end && data[pos] != 0) {
+        augmentation += data[pos++];
+    }
+    pos++;
+    encoding = 0x00; //DW_EH_PE_absptr without R augmentation
+    if (augmentation.empty()) {
+        return true;
+    }
+    if (augmentation[0] != 'z') {
+        return false;
+    }
+    eh_frame_skip_leb128(data, pos, end); //Code alignment factor
+    eh_frame_skip_leb128(data, pos, end); //Data alignment factor
+    if (version == 1) {
+        pos++; //Return address register
+    } else {
+        eh_frame_skip_leb128(data, pos, end);
+    }
+    eh_frame_skip_leb128(data, pos, end); //Augmentation data length
+    for (size_t i = 1; i < augmentation.length(); i++) {
+        if (pos >= end) {
+            return false;
+        }
+        switch (augmentation[i]) {
+            case 'R':
+                encoding = data[pos++];
+                break;
+
+            case 'L':
+                pos++; //LSDA encoding
+                break;
+
+            case 'P':
+            {
+                //Skip personality routine pointer of 2, 4, or 8 bytes
+                uint8_t personality_encoding = data[pos++] & 0x07;
+                if (personality_encoding == 0x02) {
+                    pos += 2;
+                } else if (personality_encoding == 0x00 || personality_encoding == 0x03) {
+                    pos += 4;
+                } else if (personality_encoding == 0x04) {
+                    pos += 8;
+                } else {
+                    return false;
+                }
+            }
+            break;
+
+            case 'S':
+            case 'B':
+                break;
+
+            default:
+                return false;
+        }
+    }
+    return pos <= end;
+}
+
+bool eh_frame_fde_encoding_supported(uint8_t encoding)
+{
+    //Runtime reads function size after 4-byte absolute function start
+    return encoding == 0x00 || encoding == 0x03 || encoding == 0x0B;
+}
+
+void eh_frame_hdr_build(uso_context &ctx)
+{
+    uint16_t eh_frame_section = section_get_out_index(ctx, elf_find_section(ctx, ".eh_frame"));
+    if (eh_frame_section == 0 || !ctx.out_sections[eh_frame_section].has_data) {
+        return;
+    }
+    std::vector<eh_frame_fde> fdes;
+    std::vector<ELFIO::Elf_Half> &elf_sections = ctx.out_sections[eh_frame_section].elf_sections;
+    for (size_t i = 0; i < elf_sections.size(); i++) {
+        ELFIO::section *section = ctx.elf_reader.sections[elf_sections[i]];
+        if (section->get_type() == ELFIO::SHT_NOBITS) {
+            continue;
+        }
+        std::vector<char> data(section->get_data(), section->get_data() + section->get_size());
+        uint32_t base = ctx.out_section_base[elf_sections[i]];
+        //Function start of each FDE is found through its relocation
+        const ELFIO::relocation_table &relocs = elf_get_relocs(ctx, elf_sections[i]);
+        std::unordered_map<uint32_t, ELFIO::Elf_Xword> reloc_map;
+        for (ELFIO::Elf_Xword j = 0; j < relocs.size(); j++) {
+            reloc_map[(uint32_t)relocs.offsets[j]] = j;
+        }
+        std::unordered_map<uint32_t, bool> cie_supported;
+        uint32_t offset = 0;
+        while (offset + 4 <= data.size()) {
+            uint32_t length = reloc_read_u32(data, offset);
+            if (length == 0) {
+                break;
+            }
+            //64-bit records are not used on MIPS
+            if (length < 8 || length == 0xFFFFFFFF || length > data.size() - offset - 4) {
+                ctx.log << "Invalid .eh_frame record at offset " << offset << "." << std::endl;
+                throw uso_error();
+            }
+            uint32_t cie_pointer = reloc_read_u32(data, offset + 4);
+            if (cie_pointer == 0) {
+                uint8_t encoding;
+                cie_supported[offset] = eh_frame_read_fde_encoding(data, offset, offset + length + 4, encoding) && eh_frame_fde_encoding_supported(encoding);
+            } else {
+                //Exception frames are left to libgcc if any FDE can't be put in the table
+                std::unordered_map<uint32_t, bool>::iterator cie = cie_supported.find(offset + 4 - cie_pointer);
+                if (cie == cie_supported.end() || !cie->second) {
+                    return;
+                }
+                //FDEs of functions discarded by the linker have no relocation
+                std::unordered_map<uint32_t, ELFIO::Elf_Xword>::iterator reloc = reloc_map.find(offset + 8);
+                if (reloc != reloc_map.end()) {
+                    if (relocs.types[reloc->second] != 2) { //R_MIPS_32
+                        return;
+                    }
+                    //FDEs of removed functions are skipped
+                    ELFIO::Elf_Word symbol = relocs.symbols[reloc->second];
+                    ELFIO::Elf_Half sym_section = ctx.elf_syms.sections[symbol];
+                    uint16_t func_section = section_get_out_index(ctx, sym_section);
+                    if (func_section != 0) {
+                        if (!ctx.out_sections[func_section].has_data) {
+                            return;
+                        }
+                        eh_frame_fde fde;
+                        fde.func_section = func_section;
+                        fde.func_offset = section_get_out_base(ctx, sym_section) + ctx.elf_syms.values[symbol] + reloc_read_u32(data, offset + 8);
+                        fde.fde_offset = base + offset;
+                        fdes.push_back(fde);
+                    }
+                }
+            }
+            offset += length + 4;
+        }
+    }
+    if (fdes.empty()) {
+        return;
+    }
+    //Table is filled in once section data offsets are known
+    section_info section_data;
+    section_data.has_data = true;
+    section_data.writable = false;
+    section_data.size = sizeof(uso_eh_frame_hdr_t) + (fdes.size() * USO_EH_FRAME_HDR_ENTRY_SIZE);
+    section_data.align = 4;
+    section_data.data.assign(section_data.size, 0);
+    ctx.eh_frame_hdr_section = ctx.out_sections.size();
+    ctx.out_sections.push_back(section_data);
+    ctx.eh_frame_fdes = std::move(fdes);
+}
+
+void eh_frame_hdr_fill(uso_context &ctx, std::vector<uint32_t> &section_data_ofs, uint32_t hdr_ofs)
+{
+    //Sort by file offset which keeps the same order once sections are loaded
+    uint32_t eh_frame_ofs = section_data_ofs[section_get_out_index(ctx, elf_find_section(ctx, ".eh_frame"))];
+    std::vector<std::pair<uint32_t, uint32_t>> entries(ctx.eh_frame_fdes.size());
+    for (size_t i = 0; i < ctx.eh_frame_fdes.size(); i++) {
+        entries[i].first = section_data_ofs[ctx.eh_frame_fdes[i].func_section] + ctx.eh_frame_fdes[i].func_offset - hdr_ofs;
+        entries[i].second = eh_frame_ofs + ctx.eh_frame_fdes[i].fde_offset - hdr_ofs;
+    }
+    std::sort(entries.begin(), entries.end(), [](const std::pair<uint32_t, uint32_t> &first, const std::pair<uint32_t, uint32_t> &second) {
+        return (int32_t)first.first < (int32_t)second.first;
+    });
+    uso_eh_frame_hdr_t hdr;
+    hdr.version = USO_EH_FRAME_HDR_VERSION;
+    hdr.eh_frame_ptr_enc = USO_EH_FRAME_HDR_PTR_ENC;
+    hdr.fde_count_enc = USO_EH_FRAME_HDR_COUNT_ENC;
+    hdr.table_enc = USO_EH_FRAME_HDR_TABLE_ENC;
+    hdr.eh_frame_ofs = eh_frame_ofs - (hdr_ofs + 4);
+    hdr.num_entries = entries.size();
+    std::vector<char> &data = ctx.out_sections[ctx.eh_frame_hdr_section].data;
+    memcpy(data.data(), &hdr, sizeof(uso_eh_frame_hdr_t));
+    for (size_t i = 0; i < entries.size(); i++) {
+        reloc_write_u32(data, sizeof(uso_eh_frame_hdr_t) + (i * USO_EH_FRAME_HDR_ENTRY_SIZE), entries[i].first);
+        reloc_write_u32(data, sizeof(uso_eh_frame_hdr_t) + (i * USO_EH_FRAME_HDR_ENTRY_SIZE) + 4, entries[i].second);
+    }
+}
+
+bool section_is_unwind(uso_context &ctx, size_t index)
+{
+    if (index == ctx.eh_frame_hdr_section) {
+        return true;
+    }
+    std::vector<ELFIO::Elf_Half> &elf_sections = ctx.out_sections[index].elf_sections;
+    for (size_t i = 0; i < elf_sections.size(); i++) {
+        std::string name = ctx.elf_reader.sections[elf_sections[i]]->get_name();
+        if (name != ".eh_frame" && !section_name_matches(name, ".gcc_except_table*")) {
+            return false;
+        }
+    }
+    return !elf_sections.empty();
+}
+
+void unwind_mark_sections(uso_context &ctx)
+{
+    //Unwind sections left in ROM are only found through the FDE search table
+    if (!ctx.options.unwind_in_rom || ctx.eh_frame_hdr_section == 0) {
+        return;
+    }
+    std::vector<bool> unwind(ctx.out_sections.size(), false);
+    for (size_t i = 1; i < ctx.out_sections.size(); i++) {
+        if (ctx.out_sections[i].has_data && section_is_unwind(ctx, i)) {
+            if (ctx.out_sections[i].align > USO_UNWIND_ALIGN) {
+                return;
+            }
+            unwind[i] = true;
+        }
+    }
+    //Everything is loaded with USO if loaded sections or exports point into unwind sections
+    for (size_t i = 1; i < ctx.out_sections.size(); i++) {
+        std::vector<uso_reloc_t> &relocs = ctx.out_sections[i].internal_relocs;
+        for (size_t j = 0; j < relocs.size() && !unwind[i]; j++) {
+            if (unwind[relocs[j].info & 0x3FFFFFF]) {
+                return;
+            }
+        }
+    }
+    for (size_t i = 0; i < ctx.export_syms.size(); i++) {
+        if (unwind[ctx.export_syms[i].section]) {
+            return;
+        }
+    }
+    for (size_t i = 1; i < ctx.out_sections.size(); i++) {
+        ctx.out_sections[i].unwind = unwind[i];
+    }
+}
+
+bool common_is_used(uso_context &ctx)
+{
+    //Iterate over ELF symbols
+    for (ELFIO::Elf_Xword i = 0; i < ctx.elf_syms.size(); i++) {
+        if (ctx.elf_syms.sections[i] == ELFIO::SHN_COMMON) {
+            //Terminate if any symbol is found using section SHN_COMMON
+            return true;
+        }
+    }
+    //Common section is not used
+    return false;
+}
+
+bool check_gp_relative_relocations(uso_context &ctx)
+{
+    //Iterate over relocations of all sections
+    for (size_t i = 0; i < ctx.elf_relocs.size(); i++) {
+        for (ELFIO::Elf_Xword j = 0; j < ctx.elf_relocs[i].size(); j++) {
+            unsigned int type = ctx.elf_relocs[i].types[j];
+            //Check for relocation types using GP register
+            //R_MIPS_GPREL16 (7) is allowed for main binary symbols and checked when relocations are built
+            //R_MIPS_GOT16 (9), R_MIPS_CALL16 (11), R_MIPS_CALL_HI16 (30), or R_MIPS_CALL_LO16 (31)
+            if (type == 9 || type == 11 || type == 30 || type == 31) {
+                return true;
+            }
+        }
+    }
+    //Did not find any relocations using GP
+    return false;
+}
+
+uint32_t align_val(uint32_t val, uint32_t to)
+{
+    //Only supports power of 2 alignment
+    return (val + to - 1) & ~(to - 1);
+}
+
+uint32_t uso_get_align(uso_context &ctx)
+{
+    uint32_t align = 4; //4 is minimum alignment of several USO data structures
+    //Find maximum alignment of section with loaded data
+    for (size_t i = 0; i < ctx.out_sections.size(); i++) {
+        //Only sections with loaded data are considered for USO minimum alignment calculations
+        if (ctx.out_sections[i].has_data && ctx.out_sections[i].align > align) {
+            align = ctx.out_sections[i].align;
+        }
+    }
+    return align;
+}
+
+uint32_t uso_get_noload_align(uso_context &ctx)
+{
+    uint32_t align = 1; //1 byte is global minimum alignment
+    //Find maximum alignment of section with no loaded data
+    for (size_t i = 0; i < ctx.out_sections.size(); i++) {
+        //Only consider sections without loaded data
+        if (!ctx.out_sections[i].has_data && ctx.out_sections[i].align > align) {
+            align = ctx.out_sections[i].align;
+        }
+    }
+    return align;
+}
+
+uint32_t uso_get_noload_size(uso_context &ctx)
+{
+    uint32_t size = 0;
+    //Sum up sizes of sections without loaded data
+    for (size_t i = 0; i < ctx.out_sections.size(); i++) {
+        if (!ctx.out_sections[i].has_data) {
+            size += ctx.out_sections[i].size;
+        }
+    }
+    return size;
+}
+
+uint32_t uso_calc_data_start_alignment(uso_context &ctx)
+{
+    for (size_t i = 0; i < ctx.out_sections.size(); i++) {
+        if (ctx.out_sections[i].has_data) {
+            //Return alignment of first section with allocated data
+            return ctx.out_sections[i].align;
+        }
+    }
+    //Assume 1 if no loaded data sections are provided
+    return 1;
+}
+
+uint32_t uso_get_reloc_ofs(uso_context &ctx, uint32_t data_ofs, bool unwind)
+{
+    //Find end of last data section loaded with USO or left in ROM
+    for (size_t i = 0; i < ctx.out_sections.size(); i++) {
+        if (ctx.out_sections[i].has_data && ctx.out_sections[i].unwind == unwind) {
+            data_ofs = align_val(data_ofs, ctx.out_sections[i].align); //Align next data section offset
+            data_ofs += ctx.out_sections[i].size; //Go to next data section offset
+        }
+    }
+    return data_ofs;
+}
+
+uint32_t uso_get_reloc_table_size(std::vector<uso_reloc_t> &relocs)
+{
+    return 4 + (relocs.size() * sizeof(uso_reloc_t));
+}
+
+uint32_t uso_get_relocs_end(uso_context &ctx, uint32_t relocs_ofs, bool unwind)
+{
+    for (size_t i = 0; i < ctx.out_sections.size(); i++) {
+        if (ctx.out_sections[i].unwind != unwind) {
+            continue;
+        }
+        if (ctx.out_sections[i].internal_relocs.size() > 0) {
+            relocs_ofs += uso_get_reloc_table_size(ctx.out_sections[i].internal_relocs);
+        }
+        if (ctx.out_sections[i].external_relocs.size() > 0) {
+            relocs_ofs += uso_get_reloc_table_size(ctx.out_sections[i].external_relocs);
+        }
+    }
+    return relocs_ofs;
+}
+
+bool uso_has_unwind_sections(uso_context &ctx)
+{
+    for (size_t i = 0; i < ctx.out_sections.size(); i++) {
+        if (ctx.out_sections[i].unwind) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t uso_get_unwind_ofs(uso_context &ctx, uint32_t data_ofs)
+{
+    //Unwind sections left in ROM follow relocation tables of everything else
+    uint32_t relocs_ofs = align_val(uso_get_reloc_ofs(ctx, data_ofs, false), 4);
+    return align_val(uso_get_relocs_end(ctx, relocs_ofs, false), USO_UNWIND_ALIGN);
+}
+
+uint32_t uso_get_size(uso_context &ctx, uint32_t sections_ofs)
+{
+    //Sections are followed by section data then relocation tables
+    uint32_t data_ofs = sections_ofs + (ctx.out_sections.size() * sizeof(uso_section_info_t));
+    data_ofs = align_val(data_ofs, uso_calc_data_start_alignment(ctx));
+    uint32_t size = uso_get_relocs_end(ctx, align_val(uso_get_reloc_ofs(ctx, data_ofs, false), 4), false);
+    if (uso_has_unwind_sections(ctx)) {
+        uint32_t unwind_ofs = uso_get_unwind_ofs(ctx, data_ofs);
+        size = uso_get_relocs_end(ctx, align_val(uso_get_reloc_ofs(ctx, unwind_ofs, true), 4), true);
+    }
+    //Leave room for padding and load info
+    return size + 2 + sizeof(uso_load_info);
+}
+
+void buffer_write(std::vector<uint8_t> &buf, uint32_t ofs, const void *data, size_t size)
+{
+    //Grow buffer like a file would when writing past its end
+    if (size != 0 && ofs + size > buf.size()) {
+        buf.resize(ofs + size);
+    }
+    memcpy(&buf[ofs], data, size);
+}
+
+void uso_write_elf_name(std::vector<uint8_t> &buf, uint32_t ofs, std::string name)
+{
+    buffer_write(buf, ofs, name.c_str(), name.length() + 1); //Write with NULL terminator
+}
+
+void uso_write_u32(std::vector<uint8_t> &buf, uint32_t ofs, uint32_t value)
+{
+    be_u32 count = value;
+    //Write count to offset
+    buffer_write(buf, ofs, &count, sizeof(count));
+}
+
+void uso_write_symbol_table(std::vector<uint8_t> &buf, uint32_t ofs, std::vector<symbol_info> &syms)
+{
+    uint32_t pool_ofs = 4 + (syms.size() * sizeof(uso_symbol_t));
+    //Names that are suffixes of other names share storage
+    std::string pool;
+    std::map<std::string, uint32_t> name_ofs_map;
+    sym_build_name_pool(syms, pool, name_ofs_map);
+    //Write symbol table count
+    uso_write_u32(buf, ofs, syms.size());
+    //Build all symbols before copying them to buffer
+    std::vector<uso_symbol_t> table(syms.size());
+    for (size_t i = 0; i < syms.size(); i++) {
+        //Setup symbol data
+        uint16_t name_len = syms[i].name.length();
+        uso_symbol_t &temp_sym = table[i];
+        temp_sym.name_ofs = pool_ofs + name_ofs_map[syms[i].name];
+        temp_sym.addr = syms[i].addr;
+        temp_sym.section = syms[i].section;
+        //Set name length depending on weak flag
+        if (syms[i].weak) {
+            temp_sym.name_len = name_len | USO_SYMBOL_WEAK;
+        } else {
+            temp_sym.name_len = name_len;
+        }
+    }
+    buffer_write(buf, ofs + 4, table.data(), table.size() * sizeof(uso_symbol_t));
+    //Write name pool
+    buffer_write(buf, ofs + pool_ofs, pool.data(), pool.length());
+}
+
+void uso_write_relocations(std::vector<uint8_t> &buf, uint32_t ofs, std::vector<uso_reloc_t> &relocs)
+{
+    uso_write_u32(buf, ofs, relocs.size());
+    //Copy relocations then convert every field at once
+    buffer_write(buf, ofs + 4, relocs.data(), relocs.size() * sizeof(uso_reloc_t));
+    big_endian_convert_array((uint32_t *)&buf[ofs + 4], relocs.size() * (sizeof(uso_reloc_t) / 4));
+}
+
+void uso_write_sections(uso_context &ctx, std::vector<uint8_t> &buf, uint32_t sections_ofs)
+{
+    //Calculate offsets
+    uint32_t data_ofs = sections_ofs + (ctx.out_sections.size() * sizeof(uso_section_info_t));
+    data_ofs = align_val(data_ofs, uso_calc_data_start_alignment(ctx));
+    uint32_t relocs_ofs = align_val(uso_get_reloc_ofs(ctx, data_ofs, false), 4);
+    //Unwind sections left in ROM are laid out the same way after everything else
+    uint32_t unwind_data_ofs = 0;
+    uint32_t unwind_relocs_ofs = 0;
+    if (uso_has_unwind_sections(ctx)) {
+        ctx.unwind_ofs = uso_get_unwind_ofs(ctx, data_ofs);
+        unwind_data_ofs = ctx.unwind_ofs;
+        unwind_relocs_ofs = align_val(uso_get_reloc_ofs(ctx, unwind_data_ofs, true), 4);
+        ctx.unwind_size = uso_get_relocs_end(ctx, unwind_relocs_ofs, true) - ctx.unwind_ofs;
+    }
+    std::vector<uso_section_info_t> section_table(ctx.out_sections.size());
+    std::vector<uint32_t> section_data_ofs(ctx.out_sections.size(), 0);
+    for (size_t i = 0; i < ctx.out_sections.size(); i++) {
+        //Setup section info
+        uso_section_info_t &section = section_table[i];
+        uint32_t &next_data_ofs = ctx.out_sections[i].unwind ? unwind_data_ofs : data_ofs;
+        uint32_t &next_relocs_ofs = ctx.out_sections[i].unwind ? unwind_relocs_ofs : relocs_ofs;
+        //Setup section data
+        section.data_size = ctx.out_sections[i].size;
+        uint32_t data_align = ctx.out_sections[i].align;
+        //Runtime restores data of writable sections when reopening a closed USO
+        if (ctx.out_sections[i].writable) {
+            data_align |= USO_SECTION_WRITABLE;
+        }
+        if (ctx.out_sections[i].unwind) {
+            data_align |= USO_SECTION_UNWIND;
+        }
+        section.data_align = data_align;
+        if (ctx.out_sections[i].has_data) {
+            //Calculate properly aligned section offset
+            next_data_ofs = align_val(next_data_ofs, ctx.out_sections[i].align);
+            section.data_ofs = next_data_ofs-sections_ofs;
+            section_data_ofs[i] = next_data_ofs;
+            //FDE search table is last section with data so every function offset is known
+            if (i == ctx.eh_frame_hdr_section) {
+                eh_frame_hdr_fill(ctx, section_data_ofs, next_data_ofs);
+            }
+            //Write section data
+            buffer_write(buf, next_data_ofs, ctx.out_sections[i].data.data(), ctx.out_sections[i].size);
+            next_data_ofs += ctx.out_sections[i].size; //Calculate next section data offset
+        } else {
+            section.data_ofs = 0; //Will be treated as NULL at runtime
+        }
+        //Setup internal relocations
+        section.internal_relocs_ofs = 0;
+        if (ctx.out_sections[i].internal_relocs.size() > 0) {
+            section.internal_relocs_ofs = next_relocs_ofs-sections_ofs;
+            uso_write_relocations(buf, next_relocs_ofs, ctx.out_sections[i].internal_relocs);
+            next_relocs_ofs += uso_get_reloc_table_size(ctx.out_sections[i].internal_relocs);
+        }
+        //Setup external relocations
+        section.external_relocs_ofs = 0;
+        if (ctx.out_sections[i].external_relocs.size() > 0) {
+            section.external_relocs_ofs = next_relocs_ofs-sections_ofs;
+            uso_write_relocations(buf, next_relocs_ofs, ctx.out_sections[i].external_relocs);
+            next_relocs_ofs += uso_get_reloc_table_size(ctx.out_sections[i].external_relocs);
+        }
+    }
+    //Section info table is already big endian
+    buffer_write(buf, sections_ofs, section_table.data(), section_table.size() * sizeof(uso_section_info_t));
+}
+
+void uso_write_load_info(uso_context &ctx, std::vector<uint8_t> &buf)
+{
+    uso_load_info load_info;
+    //Write padding zero to align to 2 bytes
+    if (buf.size() % 2 != 0) {
+        buf.push_back(0);
+    }
+    //Write USO load info at end of file
+    load_info.uso_size = buf.size(); //File size
+    if (ctx.unwind_size != 0) {
+        load_info.uso_size = ctx.unwind_ofs; //Unwind sections left in ROM are not loaded with USO
+    }
+    load_info.uso_align = uso_get_align(ctx);
+    load_info.noload_size = uso_get_noload_size(ctx);
+    load_info.noload_align = uso_get_noload_align(ctx);
+    buffer_write(buf, buf.size(), &load_info, sizeof(uso_load_info));
+}
+
+void uso_write_header(std::vector<uint8_t> &buf, const uso_header_t &header)
+{
+    //Write header at start of file
+    buffer_write(buf, 0, &header, sizeof(uso_header_t));
+}
+
+bool uso_write(uso_context &ctx, std::string src_elf_name, const char *path)
+{
+    //Lay out whole USO in memory and write it at once
+    std::vector<uint8_t> buf(sizeof(uso_header_t));
+    uso_header_t header;
+    //Write ELF name
+    uint32_t data_ofs = sizeof(uso_header_t);
+    uso_write_elf_name(buf, data_ofs, src_elf_name);
+    //Write import symbols
+    data_ofs += src_elf_name.size() + 1;
+    header.import_sym_table_ofs = 0;
+    header.import_debug_sym_table_ofs = 0;
+    if (ctx.import_syms.size() != 0) {
+        //Names of ordinal imports are only written to debug table
+        std::vector<symbol_info> import_table = ctx.import_syms;
+        std::vector<symbol_info> import_debug_table;
+        for (size_t i = 0; i < import_table.size() && import_table[i].section != 0; i++) {
+            import_debug_table.push_back(import_table[i]);
+            import_table[i].name.clear();
+        }
+        data_ofs = align_val(data_ofs, 4);
+        header.import_sym_table_ofs = data_ofs;
+        uso_write_symbol_table(buf, header.import_sym_table_ofs, import_table);
+        data_ofs += sym_get_data_size(import_table);
+        if (ctx.options.keep_ordinal_names && import_debug_table.size() != 0) {
+            data_ofs = align_val(data_ofs, 4);
+            header.import_debug_sym_table_ofs = data_ofs;
+            uso_write_symbol_table(buf, header.import_debug_sym_table_ofs, import_debug_table);
+            data_ofs += sym_get_data_size(import_debug_table);
+        }
+    } 
+    //Write export symbols
+    header.export_sym_table_ofs = 0;
+    if (ctx.export_syms.size() != 0) {
+        data_ofs = align_val(data_ofs, 4);
+        header.export_sym_table_ofs = data_ofs;
+        uso_write_symbol_table(buf, header.export_sym_table_ofs, ctx.export_syms);
+        data_ofs += sym_get_data_size(ctx.export_syms);
+    }
+    //Write section info
+    data_ofs = align_val(data_ofs, 4);
+    header.sections_ofs = data_ofs;
+    header.num_sections = ctx.out_sections.size();
+    //Reserve space for sections and relocations up front so buffer only grows once
+    buf.reserve(uso_get_size(ctx, header.sections_ofs));
+    uso_write_sections(ctx, buf, header.sections_ofs);
+    //Calculate section IDs of a few critical sections
+    header.eh_frame_section = section_get_out_index(ctx, elf_find_section(ctx, ".eh_frame"));
+    header.ctors_section = section_get_out_index(ctx, elf_find_section(ctx, ".ctors"));
+    header.dtors_section = section_get_out_index(ctx, elf_find_section(ctx, ".dtors"));
+    //Stamp USO with global symbol table and module set used to bind imports
+    //USOs with nothing bound to the main binary stay valid when the global symbol table changes
+    header.global_fingerprint = 0;
+    if (ctx.num_prebound_relocs != 0 || !ctx.prebound_sym_map.empty()) {
+        header.global_fingerprint = ctx.options.global_fingerprint;
+    }
+    header.module_set_fingerprint = ctx.options.module_set_fingerprint;
+    header.module_id = ctx.module_id;
+    header.eh_frame_hdr_section = ctx.eh_frame_hdr_section;
+    header.unwind_ofs = ctx.unwind_ofs;
+    header.unwind_size = ctx.unwind_size;
+    //Rewrite some critical fields
+    uso_write_header(buf, header);
+    uso_write_load_info(ctx, buf);
+    return file_write(path, buf.data(), buf.size(), ctx.options.skip_identical_output, ctx.log);
+}
+
+uint32_t global_read_u32(std::vector<char> &data, uint32_t offset)
+{
+    if (offset + 4 > data.size()) {
+        std::cerr << "Global symbol file is truncated." << std::endl;
+        exit(1);
+    }
+    return reloc_read_u32(data, offset);
+}
+
+uint16_t global_read_u16(std::vector<char> &data, uint32_t offset)
+{
+    if (offset + 2 > data.size()) {
+        std::cerr << "Global symbol file is truncated." << std::endl;
+        exit(1);
+    }
+    uint8_t *ptr = (uint8_t *)&data[offset];
+    return (ptr[0] << 8) | ptr[1];
+}
+
+uint32_t global_read_varint(std::vector<char> &data, uint32_t &offset)
+{
+    //Read 7 bits per byte until top bit is clear
+    uint32_t value = 0;
+    uint32_t shift = 0;
+    uint8_t byte;
+    do {
+        if (offset >= data.size()) {
+            std::cerr << "Global symbol file is truncated." << std::endl;
+            exit(1);
+        }
+        byte = data[offset++];
+        value |= (byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+bool global_syms_read(uso_options &options, const char *path)
+{
+    //Read whole global symbol file
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << path << " for reading." << std::endl;
+        return false;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    //Read header fields
+    uint32_t num_syms = global_read_u32(data, offsetof(uso_global_table_t, num_syms));
+    uint32_t addrs_ofs = global_read_u32(data, offsetof(uso_global_table_t, addrs_ofs));
+    uint32_t names_ofs = global_read_u32(data, offsetof(uso_global_table_t, names_ofs));
+    options.global_fingerprint = global_read_u32(data, offsetof(uso_global_table_t, fingerprint));
+    options.global_gp = global_read_u32(data, offsetof(uso_global_table_t, gp));
+    //Decode front-coded names in order along with addresses
+    std::string name;
+    for (uint32_t i = 0; i < num_syms; i++) {
+        uint32_t shared = global_read_varint(data, names_ofs);
+        uint32_t suffix_len = global_read_varint(data, names_ofs);
+        if (shared > name.length() || names_ofs + suffix_len > data.size()) {
+            std::cerr << "Global symbol file is truncated." << std::endl;
+            return false;
+        }
+        name.resize(shared);
+        name.append(data.data() + names_ofs, suffix_len);
+        names_ofs += suffix_len;
+        options.global_sym_map[name] = global_read_u32(data, addrs_ofs + (i * 4));
+    }
+    return true;
+}
+
+bool export_list_read(uso_options &options, const char *path)
+{
+    std::vector<std::string> names;
+    if (!name_list_read(path, names)) {
+        std::cerr << "Failed to open " << path << " for reading." << std::endl;
+        return false;
+    }
+    options.export_keep_set.insert(names.begin(), names.end());
+    options.prune_exports = true;
+    return true;
+}
+
+bool uso_read_symbol_names(std::vector<char> &data, uint32_t ofs, std::vector<std::string> &names)
+{
+    //Skip reading 0-offset symbol tables
+    if (ofs == 0) {
+        return true;
+    }
+    uint32_t num_syms = global_read_u32(data, ofs);
+    for (uint32_t i = 0; i < num_syms; i++) {
+        uint32_t sym_ofs = ofs + 4 + (i * sizeof(uso_symbol_t));
+        uint32_t name_ofs = global_read_u32(data, sym_ofs + offsetof(uso_symbol_t, name_ofs));
+        uint32_t name_len = global_read_u16(data, sym_ofs + offsetof(uso_symbol_t, name_len)) & USO_SYMBOL_NAME_LEN_MASK;
+        if (ofs + name_ofs + name_len > data.size()) {
+            return false;
+        }
+        names.push_back(std::string(&data[ofs + name_ofs], name_len));
+    }
+    return true;
+}
+
+bool module_set_read(uso_options &options, const char *path)
+{
+    std::ifstream manifest(path);
+    if (!manifest.is_open()) {
+        std::cerr << "Failed to open " << path << " for reading." << std::endl;
+        return false;
+    }
+    std::string uso_path;
+    while (std::getline(manifest, uso_path)) {
+        if (uso_path.empty()) {
+            continue;
+        }
+        //Read whole USO
+        std::ifstream file(uso_path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open " << uso_path << " for reading." << std::endl;
+            return false;
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < sizeof(uso_header_t) || std::find(data.begin() + sizeof(uso_header_t), data.end(), 0) == data.end()) {
+            std::cerr << "Invalid USO " << uso_path << "." << std::endl;
+            return false;
+        }
+        //Read ELF name and export symbol names
+        module_info module;
+        module.src_elf_name = &data[sizeof(uso_header_t)];
+        if (!uso_read_symbol_names(data, global_read_u32(data, offsetof(uso_header_t, export_sym_table_ofs)), module.export_names)) {
+            std::cerr << "Invalid export symbol table in " << uso_path << "." << std::endl;
+            return false;
+        }
+        //Ordinals index export tables after pruning
+        std::vector<std::string> &names = module.export_names;
+        names.erase(std::remove_if(names.begin(), names.end(), [&](const std::string &name) { return sym_is_pruned_export(options, name); }), names.end());
+        options.module_set.push_back(module);
+    }
+    //Fingerprint export tables of the module set with FNV-1a
+    uint32_t hash = 0x811C9DC5;
+    for (size_t i = 0; i < options.module_set.size(); i++) {
+        std::vector<std::string> &names = options.module_set[i].export_names;
+        for (size_t j = 0; j < names.size(); j++) {
+            for (size_t k = 0; k <= names[j].length(); k++) {
+                hash = (hash ^ (uint8_t)names[j].c_str()[k]) * 0x01000193;
+            }
+        }
+        //Separate modules so moving a symbol between modules changes hash
+        hash = (hash ^ 0xFF) * 0x01000193;
+    }
+    //Zero is reserved for USOs not in a module set
+    if (hash == 0) {
+        hash = 1;
+    }
+    options.module_set_fingerprint = hash;
+    return true;
+}
+
+uint16_t module_set_find(const uso_options &options, const char *elf_path)
+{
+    //USO built from input ELF takes module ID from its position in the set
+    for (size_t i = 0; i < options.module_set.size(); i++) {
+        if (options.module_set[i].src_elf_name == elf_path) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+bool uso_convert_elf(uso_context &ctx, const char *elf_name, const char *uso_path)
+{
+    ctx.module_id = module_set_find(ctx.options, elf_name);
+    //Do elf sanity checks
+    elf_index_sections(ctx);
+    if (!elf_valid(ctx)) {
+        ctx.log << "Input ELF file is not valid relocatable Nintendo 64 ELF file." << std::endl;
+        ctx.log << "Try linking with -r if ELF is a valid Nintendo 64 ELF file." << std::endl;
+        return false;
+    }
+    elf_read_tables(ctx);
+    //Check for limitations of shared object system
+    if (common_is_used(ctx)) {
+        ctx.log << "Common section symbols should not be in input ELF file." << std::endl;
+        ctx.log << "Pass -d to the linker or add FORCE_COMMON_ALLOCATION to the linker script to fix." << std::endl;
+        return false;
+    }
+    if (check_gp_relative_relocations(ctx)) {
+        ctx.log << "Relocations using GOT should not be present in input ELF file." << std::endl;
+        ctx.log << "Compile without -fPIC, -fpic, -mshared, or -mabicalls to fix." << std::endl;
+        return false;
+    }
+    try {
+        //Prepare for writing USO
+        if (ctx.options.gc_sections) {
+            gc_mark_sections(ctx);
+        }
+        section_collect(ctx);
+        sym_collect(ctx);
+        reloc_build(ctx);
+        eh_frame_hdr_build(ctx);
+        unwind_mark_sections(ctx);
+        //Write USO and return write status
+        return uso_write(ctx, elf_name, uso_path);
+    } catch (uso_error &) {
+        return false;
+    }
+}
+
+bool uso_convert(uso_context &ctx, const char *elf_path, const char *uso_path)
+{
+    //Try to load ELF
+    if (!ctx.elf_reader.load_mapped(elf_path)) {
+        ctx.log << "Failed to read input ELF file." << std::endl;
+        return false;
+    }
+    return uso_convert_elf(ctx, elf_path, uso_path);
+}
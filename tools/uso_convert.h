@@ -0,0 +1,149 @@
+#ifndef USO_CONVERT_H
+#define USO_CONVERT_H
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <sstream>
+#include <elfio/elfio.hpp>
+#include "uso_format.h"
+
+//Conversion of relocatable ELFs to USOs shared by elf2uso, uso-ld and uso_symbolize
+
+struct section_info {
+    std::vector<ELFIO::Elf_Half> elf_sections; //Input sections merged into section in order
+    std::vector<uso_reloc_t> internal_relocs;
+    std::vector<uso_reloc_t> external_relocs;
+    bool has_data;
+    bool writable;
+    bool unwind = false; //Left out of loaded image until an exception passes through USO
+    std::vector<char> data;
+    size_t size;
+    size_t align;
+};
+
+//Import symbols bound by ordinal store the provider module ID in section and the ordinal in addr
+struct symbol_info {
+    ELFIO::Elf_Word src_symbol;
+    std::string name;
+    uint16_t section;
+    bool weak;
+    ELFIO::Elf64_Addr addr;
+};
+
+struct module_info {
+    std::string src_elf_name;
+    std::vector<std::string> export_names; //Sorted by name so index is ordinal
+};
+
+struct section_rule {
+    std::string name;
+    std::vector<std::string> patterns; //Only a trailing * wildcard is supported
+};
+
+struct eh_frame_record {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t cie_offset; //Equal to offset for CIEs
+    ELFIO::Elf_Half pc_section; //Section of function described by FDE
+    bool live;
+    std::vector<ELFIO::Elf_Xword> relocs;
+};
+
+//FDE of a function in the USO with offsets in output sections
+struct eh_frame_fde {
+    uint16_t func_section;
+    uint32_t func_offset;
+    uint32_t fde_offset; //Relative to .eh_frame output section
+};
+
+//Options and build time binding info shared by every ELF converted at once
+struct uso_options {
+    //Main binary symbols for binding imports at build time
+    std::map<std::string, uint32_t> global_sym_map;
+    uint32_t global_fingerprint = 0;
+    uint32_t global_gp = 0; //Zero if GP-relative relocations can't be bound
+    //Module set for binding imports between USOs by ordinal
+    std::vector<module_info> module_set; //Module ID is index plus one
+    uint32_t module_set_fingerprint = 0;
+    bool keep_ordinal_names = false; //Write names of ordinal imports to debug table
+    //Remove sections unreachable from exports for ELFs built with a section per function
+    bool gc_sections = false;
+    //Merge sections left unmerged by the linker with the same rules as uso.ld
+    bool merge_sections = false;
+    //Don't touch outputs whose contents would not change
+    bool skip_identical_output = false;
+    //Leave exception unwind sections in ROM until the runtime needs them
+    bool unwind_in_rom = false;
+    //Only write exports named in export list besides hideable symbols
+    bool prune_exports = false;
+    std::unordered_set<std::string> export_keep_set;
+};
+
+//State for converting one ELF so several ELFs can be converted at once
+struct uso_context {
+    const uso_options &options; //Shared with other ELFs being converted
+    //Section map info
+    std::vector<uint16_t> out_section_map; //Indexed by ELF section, zero if section is not output
+    std::vector<uint32_t> out_section_base; //Offset of input section in output section
+    std::vector<section_info> out_sections;
+    //Symbol tables
+    std::vector<symbol_info> import_syms;
+    std::vector<symbol_info> export_syms;
+    std::map<ELFIO::Elf_Word, size_t> import_sym_map;
+    std::map<ELFIO::Elf_Word, uint32_t> prebound_sym_map; //Import symbol address by ELF symbol
+    std::vector<symbol_info> pruned_export_syms; //Exports left out because nothing imports them
+    size_t num_prebound_relocs = 0;
+    uint16_t module_id = 0; //Zero if ELF is not in module set
+    //Section garbage collection
+    std::vector<bool> section_live; //Indexed by ELF section
+    std::vector<bool> sym_referenced; //Indexed by ELF symbol
+    ELFIO::Elf_Half eh_frame_elf_section = ELFIO::SHN_UNDEF;
+    std::vector<eh_frame_record> eh_frame_records;
+    std::vector<bool> eh_frame_dead_relocs; //Relocations of records for removed functions
+    //FDE search table
+    std::vector<eh_frame_fde> eh_frame_fdes;
+    uint16_t eh_frame_hdr_section = 0; //Zero if no search table is written
+    //File range of unwind sections left in ROM
+    uint32_t unwind_ofs = 0;
+    uint32_t unwind_size = 0;
+    //ELF info
+    ELFIO::elfio elf_reader;
+    ELFIO::Elf_Half elf_symbol_sec_index;
+    std::unordered_map<std::string, ELFIO::Elf_Half> elf_section_index; //First section with each name
+    std::vector<ELFIO::Elf_Half> elf_reloc_sections; //Relocation section applied to each section
+    std::vector<ELFIO::relocation_table> elf_relocs; //Decoded relocations applied to each section
+    ELFIO::symbol_table elf_syms; //Indexed by ELF symbol
+    //Diagnostics are printed once conversion finishes so batch output stays in order
+    std::ostringstream log;
+    
+    explicit uso_context(const uso_options &options) : options(options) {}
+};
+
+//Thrown to stop converting an ELF after an error is logged
+struct uso_error {
+};
+
+//Options are filled in by these before converting any ELF
+bool global_syms_read(uso_options &options, const char *path);
+bool export_list_read(uso_options &options, const char *path);
+bool module_set_read(uso_options &options, const char *path);
+
+//Steps of conversion used on their own by uso_symbolize to rebuild USO section layout
+void elf_index_sections(uso_context &ctx);
+void elf_read_tables(uso_context &ctx);
+bool elf_valid(uso_context &ctx);
+void gc_mark_sections(uso_context &ctx);
+void section_collect(uso_context &ctx);
+uint32_t section_get_out_base(uso_context &ctx, ELFIO::Elf_Half index);
+
+uint32_t align_val(uint32_t val, uint32_t to);
+
+//Convert ELF already loaded into ctx.elf_reader
+bool uso_convert_elf(uso_context &ctx, const char *elf_name, const char *uso_path);
+//Load ELF from elf_path and convert it
+bool uso_convert(uso_context &ctx, const char *elf_path, const char *uso_path);
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef USO_FORMAT_TOOLS_H
+#define USO_FORMAT_TOOLS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../src/uso_format.h"
+
+//USO and global symbol file structures shared by the host tools
+//Fields are stored big endian and converted when they are read or assigned
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+constexpr bool host_big_endian = true;
+#else
+constexpr bool host_big_endian = false; //MSVC only targets little endian hosts
+#endif
+
+constexpr uint16_t byteswap_u16(uint16_t value)
+{
+    return (uint16_t)((value >> 8) | (value << 8));
+}
+
+constexpr uint32_t byteswap_u32(uint32_t value)
+{
+    return ((value >> 24) & 0xFF) | ((value >> 8) & 0xFF00)
+        | ((value << 8) & 0xFF0000) | ((value << 24) & 0xFF000000);
+}
+
+//Converts between host order and big endian in either direction
+template <class T> constexpr T big_endian_convert(T value)
+{
+    static_assert(sizeof(T) == 2 || sizeof(T) == 4, "Unsupported big endian field size.");
+    if constexpr (host_big_endian) {
+        return value;
+    } else if constexpr (sizeof(T) == 2) {
+        return (T)byteswap_u16((uint16_t)value);
+    } else {
+        return (T)byteswap_u32((uint32_t)value);
+    }
+}
+
+//Converts a table of values in place
+//Compiles to nothing on big endian hosts and to a vectorizable loop on little endian hosts
+template <class T> void big_endian_convert_array(T *values, size_t count)
+{
+    if constexpr (!host_big_endian) {
+        for (size_t i = 0; i < count; i++) {
+            values[i] = big_endian_convert(values[i]);
+        }
+    }
+}
+
+//Value stored big endian in file structures
+template <class T> class big_endian {
+public:
+    big_endian() = default;
+    constexpr big_endian(T value) : raw(big_endian_convert(value)) {}
+    constexpr operator T() const { return big_endian_convert(raw); }
+
+private:
+    T raw;
+};
+
+typedef big_endian<uint16_t> be_u16;
+typedef big_endian<uint32_t> be_u32;
+
+static_assert(sizeof(be_u16) == 2 && sizeof(be_u32) == 4, "Big endian fields must not be padded.");
+
+typedef struct uso_load_info {
+    be_u32 uso_size;
+    be_u32 uso_align;
+    be_u32 noload_size;
+    be_u32 noload_align;
+} uso_load_info_t;
+
+typedef struct uso_header {
+    be_u16 num_sections;
+    be_u16 eh_frame_section;
+    be_u32 sections_ofs;
+    be_u32 import_sym_table_ofs;
+    be_u32 export_sym_table_ofs;
+    be_u16 ctors_section;
+    be_u16 dtors_section;
+    be_u32 global_fingerprint; //Zero if no imports are bound at build time
+    be_u32 module_set_fingerprint; //Zero if not part of a module set
+    be_u32 import_debug_sym_table_ofs; //Names of imports bound by ordinal
+    be_u16 module_id; //Zero if not part of a module set
+    be_u16 eh_frame_hdr_section; //Zero if USO has no FDE search table
+    be_u32 unwind_ofs; //File offset of unwind sections left in ROM, zero if every section is loaded
+    be_u32 unwind_size;
+} uso_header_t;
+
+typedef struct uso_global_table {
+    be_u32 num_syms;
+    be_u32 hash_seed;
+    be_u32 num_buckets;
+    be_u32 buckets_ofs; //Relative to global table, displacement per hash bucket
+    be_u32 slots_ofs; //Relative to global table, symbol index per hash slot
+    be_u32 addrs_ofs; //Relative to global table, address per symbol sorted by name
+    be_u32 restarts_ofs; //Relative to global table, name offset per restart block
+    be_u32 names_ofs; //Relative to global table, front-coded names sorted by name
+    be_u32 fingerprint; //Hash of symbol names and addresses
+    be_u32 gp; //Value of _gp in main binary, zero if missing
+} uso_global_table_t;
+
+typedef struct uso_section_info {
+    be_u32 data_ofs;
+    be_u32 data_size;
+    be_u32 data_align; //Top bit set for writable sections
+    be_u32 internal_relocs_ofs;
+    be_u32 external_relocs_ofs;
+} uso_section_info_t;
+
+typedef struct uso_symbol {
+    be_u32 name_ofs; //Relative to symbol table, never fixed up
+    be_u32 addr;
+    be_u16 section;
+    be_u16 name_len; //Top bit used to tell if symbol is weak
+} uso_symbol_t;
+
+//Followed by pairs of function start and FDE offsets relative to table start sorted by function start
+typedef struct uso_eh_frame_hdr {
+    uint8_t version;
+    uint8_t eh_frame_ptr_enc;
+    uint8_t fde_count_enc;
+    uint8_t table_enc;
+    be_u32 eh_frame_ofs; //Relative to this field
+    be_u32 num_entries;
+} uso_eh_frame_hdr_t;
+
+//Relocations are built in host order and converted as a whole table when written
+typedef struct uso_reloc {
+    uint32_t offset;
+    uint32_t info; //Upper 6 bits are relocation type, lower 26 bits are either symbol or section index
+    uint32_t sym_offset; //Section-relative symbol offset, zero for external relocations
+} uso_reloc_t;
+
+static_assert(sizeof(uso_load_info_t) == USO_LOAD_INFO_SIZE, "Invalid uso_load_info_t size.");
+static_assert(sizeof(uso_header_t) == USO_HEADER_SIZE, "Invalid uso_header_t size.");
+static_assert(sizeof(uso_global_table_t) == USO_GLOBAL_TABLE_SIZE, "Invalid uso_global_table_t size.");
+static_assert(sizeof(uso_section_info_t) == USO_SECTION_SIZE, "Invalid uso_section_info_t size.");
+static_assert(sizeof(uso_symbol_t) == USO_SYMBOL_SIZE, "Invalid uso_symbol_t size.");
+static_assert(sizeof(uso_eh_frame_hdr_t) == USO_EH_FRAME_HDR_SIZE, "Invalid uso_eh_frame_hdr_t size.");
+static_assert(sizeof(uso_reloc_t) == USO_RELOC_SIZE, "Invalid uso_reloc_t size.");
+
+#endif
@@ -0,0 +1,735 @@
+#define _CRT_SECURE_NO_WARNINGS //Shut up Visual Studio
+#include <stdio.h>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <set>
+#include "uso_convert.h"
+
+//MIPS-specific section types holding data never used at runtime
+#define SHT_MIPS_REGINFO 0x70000006
+#define SHT_MIPS_ABIFLAGS 0x7000002A
+
+//Null section and section name table come before linked sections in output ELF
+#define OUT_FIRST_SECTION 2
+
+//Output section an input section was placed in
+struct input_section_ref {
+    ELFIO::Elf_Half out_section; //SHN_UNDEF if section is not linked
+    uint32_t base; //Offset of input section in output section
+};
+
+struct input_object {
+    std::string name; //Object path or archive path with member name
+    ELFIO::elfio elf;
+    ELFIO::Elf_Half symbol_sec_index;
+    ELFIO::symbol_table syms;
+    std::vector<bool> section_discarded; //Set for sections of duplicate COMDAT groups
+    std::vector<input_section_ref> section_refs;
+    std::vector<ELFIO::Elf_Word> out_syms; //Output symbol per input symbol
+};
+
+struct archive_member {
+    std::string name;
+    std::unique_ptr<input_object> object; //NULL once linked
+};
+
+//Global symbol after resolving every definition and reference across objects
+struct link_symbol {
+    std::string name;
+    input_object *def_object; //NULL if symbol is undefined or common
+    ELFIO::Elf_Xword def_index;
+    bool def_weak;
+    bool common;
+    ELFIO::Elf_Xword common_size;
+    ELFIO::Elf_Xword common_align;
+    bool strong_ref; //Undefined symbol is weak unless some reference is strong
+    unsigned char visibility;
+    ELFIO::Elf_Word out_index;
+};
+
+struct output_section {
+    std::string name;
+    ELFIO::Elf_Word type;
+    ELFIO::Elf_Xword flags;
+    ELFIO::Elf_Xword align;
+    std::string data; //Unused for SHT_NOBITS sections
+    ELFIO::Elf_Xword size;
+    std::string relocs; //Big-endian Elf32_Rel entries
+};
+
+//Linked objects in link order
+std::vector<std::unique_ptr<input_object>> objects;
+//Archives whose members are linked when they define an undefined symbol
+std::vector<std::vector<archive_member>> archives;
+
+std::vector<link_symbol> link_syms;
+std::unordered_map<std::string, size_t> link_sym_map;
+std::set<std::string> comdat_signatures;
+
+std::vector<output_section> out_sections; //Index is output ELF section index minus OUT_FIRST_SECTION
+std::unordered_map<std::string, ELFIO::Elf_Half> out_shared_sections; //Sections concatenated across objects
+ELFIO::Elf_Word out_discarded_sym; //Absolute symbol for references to discarded sections
+std::string out_symtab;
+std::string out_strtab;
+ELFIO::Elf_Word out_num_local_syms;
+ELFIO::Elf_Word out_elf_flags;
+
+//Sections the runtime finds by name must stay as one section
+std::vector<std::string> shared_section_names = {
+    ".eh_frame",
+    ".ctors",
+    ".dtors"
+};
+
+void put_u32(std::string &data, uint32_t value)
+{
+    //Write in big endian
+    data += (char)(value >> 24);
+    data += (char)(value >> 16);
+    data += (char)(value >> 8);
+    data += (char)value;
+}
+
+void put_u16(std::string &data, uint16_t value)
+{
+    data += (char)(value >> 8);
+    data += (char)value;
+}
+
+uint32_t get_u32(const char *data)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    return (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+}
+
+bool object_load(input_object &object, std::istream &stream)
+{
+    if (!object.elf.load(stream)) {
+        std::cerr << "Failed to read " << object.name << "." << std::endl;
+        return false;
+    }
+    if (object.elf.get_class() != ELFIO::ELFCLASS32 || object.elf.get_encoding() != ELFIO::ELFDATA2MSB
+        || object.elf.get_machine() != ELFIO::EM_MIPS || object.elf.get_type() != ELFIO::ET_REL) {
+        std::cerr << object.name << " is not a relocatable Nintendo 64 ELF file." << std::endl;
+        return false;
+    }
+    //Objects without symbols are allowed
+    object.symbol_sec_index = ELFIO::SHN_UNDEF;
+    for (ELFIO::Elf_Half i = 0; i < object.elf.sections.size(); i++) {
+        if (object.elf.sections[i]->get_type() == ELFIO::SHT_SYMTAB) {
+            object.symbol_sec_index = i;
+            break;
+        }
+    }
+    if (object.symbol_sec_index != ELFIO::SHN_UNDEF) {
+        ELFIO::symbol_section_accessor sym_accessor(object.elf, object.elf.sections[object.symbol_sec_index]);
+        sym_accessor.get_symbols(object.syms);
+    }
+    object.section_discarded.assign(object.elf.sections.size(), false);
+    return true;
+}
+
+bool archive_read(const char *path, std::vector<archive_member> &members)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << path << " for reading." << std::endl;
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string long_names;
+    size_t ofs = 8; //Skip !<arch>\n
+    while (ofs + 60 <= data.size()) {
+        //Member header is name, date, owner, group, mode, size, and magic
+        std::string name = data.substr(ofs, 16);
+        size_t size = strtoul(data.substr(ofs + 48, 10).c_str(), NULL, 10);
+        ofs += 60;
+        if (size > data.size() - ofs) {
+            std::cerr << "Archive " << path << " is truncated." << std::endl;
+            return false;
+        }
+        std::string contents = data.substr(ofs, size);
+        ofs += size + (size % 2); //Members are 2-byte aligned
+        name.erase(name.find_last_not_of(' ') + 1);
+        if (name == "/" || name == "/SYM64/" || name == "__.SYMDEF" || name == "__.SYMDEF SORTED") {
+            //Symbol index is rebuilt from members
+            continue;
+        }
+        if (name == "//") {
+            long_names = contents;
+            continue;
+        }
+        if (name.length() > 1 && name[0] == '/') {
+            //GNU long name is offset into long name table terminated by /
+            size_t name_ofs = strtoul(name.c_str() + 1, NULL, 10);
+            if (name_ofs >= long_names.size()) {
+                std::cerr << "Archive " << path << " has invalid member name." << std::endl;
+                return false;
+            }
+            name = long_names.substr(name_ofs, long_names.find('\n', name_ofs) - name_ofs);
+        } else if (name.compare(0, 3, "#1/") == 0) {
+            //BSD long name is stored before member data
+            size_t name_len = strtoul(name.c_str() + 3, NULL, 10);
+            name = contents.substr(0, name_len);
+            contents.erase(0, name_len);
+            name.erase(name.find_last_not_of('\0') + 1);
+        }
+        if (!name.empty() && name.back() == '/') {
+            name.pop_back();
+        }
+        archive_member member;
+        member.name = std::string(path) + "(" + name + ")";
+        member.object.reset(new input_object);
+        member.object->name = member.name;
+        std::istringstream stream(contents);
+        if (!object_load(*member.object, stream)) {
+            return false;
+        }
+        members.push_back(std::move(member));
+    }
+    return true;
+}
+
+bool input_read(const char *path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << path << " for reading." << std::endl;
+        return false;
+    }
+    char magic[8] = {};
+    file.read(magic, sizeof(magic));
+    if (memcmp(magic, "!<thin>\n", 8) == 0) {
+        std::cerr << "Thin archive " << path << " is not supported." << std::endl;
+        return false;
+    }
+    if (memcmp(magic, "!<arch>\n", 8) == 0) {
+        archives.emplace_back();
+        return archive_read(path, archives.back());
+    }
+    file.seekg(0);
+    std::unique_ptr<input_object> object(new input_object);
+    object->name = path;
+    if (!object_load(*object, file)) {
+        return false;
+    }
+    objects.push_back(std::move(object));
+    return true;
+}
+
+unsigned char sym_get_visibility_rank(unsigned char other)
+{
+    //Most constraining visibility wins: internal, hidden, protected, then default
+    static const unsigned char ranks[4] = { 0, 3, 2, 1 };
+    return ranks[other & 0x3];
+}
+
+link_symbol &sym_get_link_symbol(const std::string &name)
+{
+    std::unordered_map<std::string, size_t>::iterator found = link_sym_map.find(name);
+    if (found != link_sym_map.end()) {
+        return link_syms[found->second];
+    }
+    link_symbol symbol;
+    symbol.name = name;
+    symbol.def_object = NULL;
+    symbol.def_index = 0;
+    symbol.def_weak = false;
+    symbol.common = false;
+    symbol.common_size = 0;
+    symbol.common_align = 1;
+    symbol.strong_ref = false;
+    symbol.visibility = ELFIO::STV_DEFAULT;
+    symbol.out_index = 0;
+    link_sym_map[name] = link_syms.size();
+    link_syms.push_back(symbol);
+    return link_syms.back();
+}
+
+void comdat_resolve(input_object &object)
+{
+    for (ELFIO::Elf_Half i = 0; i < object.elf.sections.size(); i++) {
+        ELFIO::section *section = object.elf.sections[i];
+        //Old-style link-once sections are deduplicated by name
+        if (section->get_name().compare(0, 14, ".gnu.linkonce.") == 0 && !comdat_signatures.insert(section->get_name()).second) {
+            object.section_discarded[i] = true;
+            continue;
+        }
+        if (section->get_type() != ELFIO::SHT_GROUP || section->get_size() < 4) {
+            continue;
+        }
+        const char *data = section->get_data();
+        //First word holds group flags and the rest are member sections
+        if (!(get_u32(data) & ELFIO::GRP_COMDAT) || section->get_info() >= object.syms.size()) {
+            continue;
+        }
+        if (comdat_signatures.insert(std::string(object.syms.names[section->get_info()])).second) {
+            continue;
+        }
+        //Group was already linked from an earlier object
+        for (ELFIO::Elf_Xword j = 4; j + 4 <= section->get_size(); j += 4) {
+            ELFIO::Elf_Word member = get_u32(data + j);
+            if (member < object.section_discarded.size()) {
+                object.section_discarded[member] = true;
+            }
+        }
+    }
+}
+
+bool sym_resolve(input_object &object)
+{
+    ELFIO::symbol_table &syms = object.syms;
+    for (ELFIO::Elf_Xword i = 1; i < syms.size(); i++) {
+        if (syms.binds[i] == ELFIO::STB_LOCAL) {
+            continue;
+        }
+        link_symbol &link_sym = sym_get_link_symbol(std::string(syms.names[i]));
+        if (sym_get_visibility_rank(syms.others[i]) > sym_get_visibility_rank(link_sym.visibility)) {
+            link_sym.visibility = syms.others[i] & 0x3;
+        }
+        ELFIO::Elf_Half section = syms.sections[i];
+        bool discarded = section < object.section_discarded.size() && object.section_discarded[section];
+        if (section == ELFIO::SHN_UNDEF || discarded) {
+            //Definitions in discarded groups resolve to the linked copy
+            if (syms.binds[i] != ELFIO::STB_WEAK) {
+                link_sym.strong_ref = true;
+            }
+        } else if (section == ELFIO::SHN_COMMON) {
+            //Common symbols take the largest size and alignment
+            link_sym.common = true;
+            if (syms.sizes[i] > link_sym.common_size) {
+                link_sym.common_size = syms.sizes[i];
+            }
+            if (syms.values[i] > link_sym.common_align) {
+                link_sym.common_align = syms.values[i];
+            }
+        } else {
+            bool weak = syms.binds[i] == ELFIO::STB_WEAK;
+            if (link_sym.def_object && !link_sym.def_weak && !weak) {
+                std::cerr << "Multiple definitions of " << link_sym.name << " in " << link_sym.def_object->name;
+                std::cerr << " and " << object.name << "." << std::endl;
+                return false;
+            }
+            //Strong definitions replace weak definitions
+            if (!link_sym.def_object || (link_sym.def_weak && !weak)) {
+                link_sym.def_object = &object;
+                link_sym.def_index = i;
+                link_sym.def_weak = weak;
+            }
+        }
+    }
+    return true;
+}
+
+bool sym_is_needed(link_symbol &symbol)
+{
+    //Archive members are only linked to define symbols referenced strongly
+    return symbol.strong_ref && !symbol.def_object && !symbol.common;
+}
+
+bool archive_member_is_needed(input_object &object)
+{
+    ELFIO::symbol_table &syms = object.syms;
+    for (ELFIO::Elf_Xword i = 1; i < syms.size(); i++) {
+        if (syms.binds[i] == ELFIO::STB_LOCAL || syms.sections[i] == ELFIO::SHN_UNDEF || syms.sections[i] == ELFIO::SHN_COMMON) {
+            continue;
+        }
+        std::unordered_map<std::string, size_t>::iterator found = link_sym_map.find(std::string(syms.names[i]));
+        if (found != link_sym_map.end() && sym_is_needed(link_syms[found->second])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool link_objects()
+{
+    for (size_t i = 0; i < objects.size(); i++) {
+        comdat_resolve(*objects[i]);
+        if (!sym_resolve(*objects[i])) {
+            return false;
+        }
+    }
+    //Link archive members until every archive is searched without linking a member
+    bool linked_member;
+    do {
+        linked_member = false;
+        for (size_t i = 0; i < archives.size(); i++) {
+            for (size_t j = 0; j < archives[i].size(); j++) {
+                archive_member &member = archives[i][j];
+                if (!member.object || !archive_member_is_needed(*member.object)) {
+                    continue;
+                }
+                comdat_resolve(*member.object);
+                if (!sym_resolve(*member.object)) {
+                    return false;
+                }
+                objects.push_back(std::move(member.object));
+                linked_member = true;
+            }
+        }
+    } while (linked_member);
+    //Modules get a private __dso_handle like uso.ld provides
+    std::unordered_map<std::string, size_t>::iterator dso_handle = link_sym_map.find("__dso_handle");
+    if (dso_handle != link_sym_map.end() && !link_syms[dso_handle->second].def_object) {
+        link_syms[dso_handle->second].common = true;
+        link_syms[dso_handle->second].common_size = 4;
+        link_syms[dso_handle->second].common_align = 4;
+    }
+    return true;
+}
+
+bool section_is_linked(input_object &object, ELFIO::Elf_Half index)
+{
+    ELFIO::section *section = object.elf.sections[index];
+    if (!(section->get_flags() & ELFIO::SHF_ALLOC) || object.section_discarded[index]) {
+        return false;
+    }
+    //Register info and ABI flags are only used by linkers
+    return section->get_type() != SHT_MIPS_REGINFO && section->get_type() != SHT_MIPS_ABIFLAGS && section->get_type() != ELFIO::SHT_GROUP;
+}
+
+ELFIO::Elf_Half section_add(const std::string &name, ELFIO::Elf_Word type, ELFIO::Elf_Xword flags)
+{
+    output_section section;
+    section.name = name;
+    section.type = type;
+    section.flags = flags;
+    section.align = 1;
+    section.size = 0;
+    out_sections.push_back(section);
+    return out_sections.size() - 1 + OUT_FIRST_SECTION;
+}
+
+uint32_t section_append(ELFIO::Elf_Half index, ELFIO::section *section)
+{
+    output_section &out_section = out_sections[index - OUT_FIRST_SECTION];
+    ELFIO::Elf_Xword align = section->get_addr_align();
+    uint32_t base = out_section.size;
+    if (align > 1) {
+        base = (base + align - 1) & ~(align - 1);
+    }
+    if (align > out_section.align) {
+        out_section.align = align;
+    }
+    out_section.size = base + section->get_size();
+    if (section->get_type() != ELFIO::SHT_NOBITS) {
+        out_section.type = section->get_type();
+        out_section.data.resize(base, 0);
+        out_section.data.append(section->get_data(), section->get_size());
+    }
+    out_section.flags |= section->get_flags() & (ELFIO::SHF_WRITE | ELFIO::SHF_EXECINSTR);
+    return base;
+}
+
+void section_layout()
+{
+    for (size_t i = 0; i < objects.size(); i++) {
+        input_object &object = *objects[i];
+        object.section_refs.assign(object.elf.sections.size(), { ELFIO::SHN_UNDEF, 0 });
+        for (ELFIO::Elf_Half j = 1; j < object.elf.sections.size(); j++) {
+            if (!section_is_linked(object, j)) {
+                continue;
+            }
+            ELFIO::section *section = object.elf.sections[j];
+            const std::string &name = section->get_name();
+            ELFIO::Elf_Half out_section;
+            if (std::find(shared_section_names.begin(), shared_section_names.end(), name) != shared_section_names.end()) {
+                std::unordered_map<std::string, ELFIO::Elf_Half>::iterator shared = out_shared_sections.find(name);
+                if (shared == out_shared_sections.end()) {
+                    out_section = section_add(name, section->get_type(), section->get_flags());
+                    out_shared_sections[name] = out_section;
+                } else {
+                    out_section = shared->second;
+                }
+            } else {
+                //Other sections are merged by uso_convert with the same rules as uso.ld
+                out_section = section_add(name, section->get_type(), section->get_flags());
+            }
+            object.section_refs[j].out_section = out_section;
+            object.section_refs[j].base = section_append(out_section, section);
+        }
+    }
+    //Exception frames are terminated like uso.ld does
+    ELFIO::Elf_Half eh_frame;
+    if (out_shared_sections.find(".eh_frame") == out_shared_sections.end()) {
+        eh_frame = section_add(".eh_frame", ELFIO::SHT_PROGBITS, ELFIO::SHF_ALLOC);
+        out_shared_sections[".eh_frame"] = eh_frame;
+    } else {
+        eh_frame = out_shared_sections[".eh_frame"];
+    }
+    output_section &eh_frame_section = out_sections[eh_frame - OUT_FIRST_SECTION];
+    if (eh_frame_section.align < 4) {
+        eh_frame_section.align = 4;
+    }
+    eh_frame_section.size = align_val(eh_frame_section.size, 4) + 4;
+    eh_frame_section.data.resize(eh_frame_section.size, 0);
+}
+
+void sym_add(const std::string &name, ELFIO::Elf64_Addr value, ELFIO::Elf_Xword size, unsigned char bind, unsigned char type, unsigned char other, ELFIO::Elf_Half section)
+{
+    put_u32(out_symtab, name.empty() ? 0 : out_strtab.size());
+    if (!name.empty()) {
+        out_strtab += name;
+        out_strtab += '\0';
+    }
+    put_u32(out_symtab, value);
+    put_u32(out_symtab, size);
+    out_symtab += (char)((bind << 4) | (type & 0xF));
+    out_symtab += (char)other;
+    put_u16(out_symtab, section);
+}
+
+ELFIO::Elf_Word sym_get_count()
+{
+    return out_symtab.size() / 16;
+}
+
+void sym_layout()
+{
+    out_strtab.assign(1, '\0');
+    sym_add("", 0, 0, ELFIO::STB_LOCAL, ELFIO::STT_NOTYPE, 0, ELFIO::SHN_UNDEF);
+    //References to discarded sections resolve to address 0 like ld
+    out_discarded_sym = sym_get_count();
+    sym_add("", 0, 0, ELFIO::STB_LOCAL, ELFIO::STT_NOTYPE, 0, ELFIO::SHN_ABS);
+    //Local symbols must come first
+    for (size_t i = 0; i < objects.size(); i++) {
+        input_object &object = *objects[i];
+        ELFIO::symbol_table &syms = object.syms;
+        object.out_syms.assign(syms.size(), out_discarded_sym);
+        for (ELFIO::Elf_Xword j = 1; j < syms.size(); j++) {
+            if (syms.binds[j] != ELFIO::STB_LOCAL || syms.types[j] == ELFIO::STT_FILE) {
+                continue;
+            }
+            ELFIO::Elf_Half section = syms.sections[j];
+            if (section == ELFIO::SHN_ABS) {
+                object.out_syms[j] = sym_get_count();
+                sym_add(std::string(syms.names[j]), syms.values[j], syms.sizes[j], syms.binds[j], syms.types[j], syms.others[j], ELFIO::SHN_ABS);
+            } else if (section < object.section_refs.size() && object.section_refs[section].out_section != ELFIO::SHN_UNDEF) {
+                input_section_ref &ref = object.section_refs[section];
+                object.out_syms[j] = sym_get_count();
+                sym_add(std::string(syms.names[j]), syms.values[j] + ref.base, syms.sizes[j], syms.binds[j], syms.types[j], syms.others[j], ref.out_section);
+            }
+        }
+    }
+    out_num_local_syms = sym_get_count();
+    //Common symbols are allocated in their own .bss after other sections
+    ELFIO::Elf_Half common_section = ELFIO::SHN_UNDEF;
+    for (size_t i = 0; i < link_syms.size(); i++) {
+        link_symbol &symbol = link_syms[i];
+        symbol.out_index = sym_get_count();
+        if (symbol.def_object) {
+            ELFIO::symbol_table &def_syms = symbol.def_object->syms;
+            ELFIO::Elf_Half section = def_syms.sections[symbol.def_index];
+            ELFIO::Elf64_Addr value = def_syms.values[symbol.def_index];
+            if (section < symbol.def_object->section_refs.size()) {
+                input_section_ref &ref = symbol.def_object->section_refs[section];
+                section = ref.out_section;
+                value += ref.base;
+            }
+            sym_add(symbol.name, value, def_syms.sizes[symbol.def_index], def_syms.binds[symbol.def_index], def_syms.types[symbol.def_index], symbol.visibility, section);
+        } else if (symbol.common) {
+            if (common_section == ELFIO::SHN_UNDEF) {
+                common_section = section_add(".bss", ELFIO::SHT_NOBITS, ELFIO::SHF_ALLOC | ELFIO::SHF_WRITE);
+            }
+            output_section &section = out_sections[common_section - OUT_FIRST_SECTION];
+            uint32_t value = align_val(section.size, symbol.common_align);
+            section.size = value + symbol.common_size;
+            if (symbol.common_align > section.align) {
+                section.align = symbol.common_align;
+            }
+            sym_add(symbol.name, value, symbol.common_size, ELFIO::STB_GLOBAL, ELFIO::STT_OBJECT, symbol.visibility, common_section);
+        } else {
+            sym_add(symbol.name, 0, 0, symbol.strong_ref ? ELFIO::STB_GLOBAL : ELFIO::STB_WEAK, ELFIO::STT_NOTYPE, symbol.visibility, ELFIO::SHN_UNDEF);
+        }
+    }
+    //Point global symbols of each object at resolved symbols
+    for (size_t i = 0; i < objects.size(); i++) {
+        input_object &object = *objects[i];
+        for (ELFIO::Elf_Xword j = 1; j < object.syms.size(); j++) {
+            if (object.syms.binds[j] != ELFIO::STB_LOCAL) {
+                object.out_syms[j] = link_syms[link_sym_map[std::string(object.syms.names[j])]].out_index;
+            }
+        }
+    }
+}
+
+void reloc_layout()
+{
+    for (size_t i = 0; i < objects.size(); i++) {
+        input_object &object = *objects[i];
+        for (ELFIO::Elf_Half j = 1; j < object.elf.sections.size(); j++) {
+            ELFIO::section *reloc_section = object.elf.sections[j];
+            //Relocations of sections that are not linked are dropped
+            if (reloc_section->get_type() != ELFIO::SHT_REL || reloc_section->get_info() >= object.section_refs.size()) {
+                continue;
+            }
+            input_section_ref &ref = object.section_refs[reloc_section->get_info()];
+            if (ref.out_section == ELFIO::SHN_UNDEF) {
+                continue;
+            }
+            std::string &relocs = out_sections[ref.out_section - OUT_FIRST_SECTION].relocs;
+            ELFIO::relocation_section_accessor reloc_accessor(object.elf, reloc_section);
+            ELFIO::relocation_table entries;
+            reloc_accessor.get_entries(entries);
+            for (ELFIO::Elf_Xword k = 0; k < entries.size(); k++) {
+                ELFIO::Elf_Word symbol = entries.symbols[k];
+                ELFIO::Elf_Word out_symbol = symbol < object.out_syms.size() ? object.out_syms[symbol] : out_discarded_sym;
+                put_u32(relocs, entries.offsets[k] + ref.base);
+                put_u32(relocs, (out_symbol << 8) | (entries.types[k] & 0xFF));
+            }
+        }
+    }
+}
+
+bool elf_build(ELFIO::elfio &elf)
+{
+    if (out_sections.size() + 3 >= ELFIO::SHN_LORESERVE) {
+        std::cerr << "Too many sections to link." << std::endl;
+        return false;
+    }
+    elf.create(ELFIO::ELFCLASS32, ELFIO::ELFDATA2MSB);
+    elf.set_type(ELFIO::ET_REL);
+    elf.set_machine(ELFIO::EM_MIPS);
+    elf.set_flags(out_elf_flags);
+    //Sections are added in the order their indices were assigned
+    for (size_t i = 0; i < out_sections.size(); i++) {
+        ELFIO::section *section = elf.sections.add(out_sections[i].name);
+        section->set_type(out_sections[i].type);
+        section->set_flags(out_sections[i].flags);
+        section->set_addr_align(out_sections[i].align);
+        if (out_sections[i].type == ELFIO::SHT_NOBITS) {
+            section->set_size(out_sections[i].size);
+        } else {
+            out_sections[i].data.resize(out_sections[i].size, 0);
+            section->set_data(out_sections[i].data.data(), out_sections[i].data.size());
+        }
+    }
+    ELFIO::section *strtab = elf.sections.add(".strtab");
+    strtab->set_type(ELFIO::SHT_STRTAB);
+    strtab->set_addr_align(1);
+    strtab->set_data(out_strtab.data(), out_strtab.size());
+    ELFIO::section *symtab = elf.sections.add(".symtab");
+    symtab->set_type(ELFIO::SHT_SYMTAB);
+    symtab->set_addr_align(4);
+    symtab->set_entry_size(16);
+    symtab->set_link(strtab->get_index());
+    symtab->set_info(out_num_local_syms);
+    symtab->set_data(out_symtab.data(), out_symtab.size());
+    for (size_t i = 0; i < out_sections.size(); i++) {
+        if (out_sections[i].relocs.empty()) {
+            continue;
+        }
+        ELFIO::section *section = elf.sections.add(".rel" + out_sections[i].name);
+        section->set_type(ELFIO::SHT_REL);
+        section->set_flags(ELFIO::SHF_INFO_LINK);
+        section->set_addr_align(4);
+        section->set_entry_size(8);
+        section->set_link(symtab->get_index());
+        section->set_info(i + OUT_FIRST_SECTION);
+        section->set_data(out_sections[i].relocs.data(), out_sections[i].relocs.size());
+    }
+    return true;
+}
+
+bool link(ELFIO::elfio &elf)
+{
+    if (!link_objects()) {
+        return false;
+    }
+    if (objects.empty()) {
+        std::cerr << "No objects to link." << std::endl;
+        return false;
+    }
+    out_elf_flags = objects[0]->elf.get_flags();
+    section_layout();
+    sym_layout();
+    reloc_layout();
+    //Linked ELF is built straight into the converter's reader
+    return elf_build(elf);
+}
+
+void print_usage(char *name)
+{
+    std::cout << "Usage: " << name << " [-c] [-u] [-x] [-g global_syms] [-e export_list] [-m manifest [-n]] [-s elf_name] [-w linked_elf] -o uso_output input..." << std::endl;
+    std::cout << "Each input is a relocatable Nintendo 64 ELF file or an archive of them." << std::endl;
+    std::cout << "Archive members are linked when they define a symbol that is still undefined." << std::endl;
+    std::cout << "Sections are merged with the same rules as uso.ld and the USO is written to uso_output." << std::endl;
+    std::cout << "elf_name is the ELF name recorded in the USO and matched against manifest." << std::endl;
+    std::cout << "It defaults to uso_output." << std::endl;
+    std::cout << "-w writes the linked ELF to linked_elf for uso_symbolize -d to read back." << std::endl;
+    std::cout << "Other options are the same as elf2uso." << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    int arg_idx = 1;
+    uso_options options;
+    const char *manifest_path = NULL;
+    const char *uso_path = NULL;
+    const char *elf_name = NULL;
+    const char *linked_elf_path = NULL;
+    //Parse options
+    while (arg_idx < argc && argv[arg_idx][0] == '-') {
+        std::string option = argv[arg_idx++];
+        if (option == "-g" && arg_idx < argc) {
+            if (!global_syms_read(options, argv[arg_idx++])) {
+                return 1;
+            }
+        } else if (option == "-e" && arg_idx < argc) {
+            if (!export_list_read(options, argv[arg_idx++])) {
+                return 1;
+            }
+        } else if (option == "-m" && arg_idx < argc) {
+            manifest_path = argv[arg_idx++];
+        } else if (option == "-n") {
+            options.keep_ordinal_names = true;
+        } else if (option == "-c") {
+            options.gc_sections = true;
+        } else if (option == "-u") {
+            options.skip_identical_output = true;
+        } else if (option == "-x") {
+            options.unwind_in_rom = true;
+        } else if (option == "-o" && arg_idx < argc) {
+            uso_path = argv[arg_idx++];
+        } else if (option == "-s" && arg_idx < argc) {
+            elf_name = argv[arg_idx++];
+        } else if (option == "-w" && arg_idx < argc) {
+            linked_elf_path = argv[arg_idx++];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    //Show usage if too few arguments are passed
+    if (!uso_path || arg_idx == argc) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (!elf_name) {
+        elf_name = uso_path;
+    }
+    //Linked sections are always merged as uso.ld would
+    options.merge_sections = true;
+    if (manifest_path && !module_set_read(options, manifest_path)) {
+        return 1;
+    }
+    for (int i = arg_idx; i < argc; i++) {
+        if (!input_read(argv[i])) {
+            return 1;
+        }
+    }
+    uso_context ctx(options);
+    if (!link(ctx.elf_reader)) {
+        return 1;
+    }
+    if (linked_elf_path && !ctx.elf_reader.save(linked_elf_path)) {
+        std::cerr << "Failed to write linked ELF to " << linked_elf_path << "." << std::endl;
+        return 1;
+    }
+    bool success = uso_convert_elf(ctx, elf_name, uso_path);
+    std::cerr << ctx.log.str();
+    return success ? 0 : 1;
+}
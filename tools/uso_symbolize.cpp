@@ -0,0 +1,291 @@
+#define _CRT_SECURE_NO_WARNINGS //Shut up Visual Studio
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include "uso_convert.h"
+
+//Maps samples printed by uso_profile_dump back to functions
+//USO section layout is rebuilt from each source ELF the same way elf2uso lays it out
+
+struct func_info {
+    uint32_t start;
+    uint32_t end;
+    std::string name;
+};
+
+struct profile_module {
+    std::string name;
+    std::string src_elf_name;
+    std::unique_ptr<uso_context> ctx; //NULL if source ELF couldn't be read
+    std::vector<std::vector<func_info>> funcs; //Indexed by ELF section, sorted by start
+};
+
+std::vector<profile_module> module_list;
+uso_options convert_options; //Same options USOs were converted with
+std::vector<func_info> main_funcs; //Sorted by start
+std::map<std::string, uint32_t> func_samples; //Sample count by function and module
+uint32_t total_samples;
+
+bool func_compare(const func_info &first, const func_info &second)
+{
+    return first.start < second.start;
+}
+
+void func_sort(std::vector<func_info> &funcs, uint32_t limit)
+{
+    std::sort(funcs.begin(), funcs.end(), func_compare);
+    //Functions without a size such as those written in assembly end at next function or limit
+    for (size_t i = 0; i < funcs.size(); i++) {
+        if (funcs[i].end == funcs[i].start) {
+            funcs[i].end = (i + 1 < funcs.size()) ? funcs[i + 1].start : limit;
+        }
+    }
+}
+
+void func_collect(const ELFIO::symbol_table &syms, std::vector<std::vector<func_info>> &funcs, bool by_section)
+{
+    for (size_t i = 0; i < syms.size(); i++) {
+        if (syms.types[i] != ELFIO::STT_FUNC) {
+            continue;
+        }
+        size_t section = by_section ? syms.sections[i] : 0;
+        if (section >= funcs.size()) {
+            continue;
+        }
+        func_info func = { (uint32_t)syms.values[i], (uint32_t)(syms.values[i] + syms.sizes[i]), std::string(syms.names[i]) };
+        funcs[section].push_back(func);
+    }
+}
+
+const func_info *func_find(const std::vector<func_info> &funcs, uint32_t addr)
+{
+    //Find last function starting at or before address
+    func_info key = { addr, addr, "" };
+    std::vector<func_info>::const_iterator func = std::upper_bound(funcs.begin(), funcs.end(), key, func_compare);
+    if (func == funcs.begin() || addr >= (func - 1)->end) {
+        return NULL;
+    }
+    return &*(func - 1);
+}
+
+bool main_elf_read(const char *path)
+{
+    ELFIO::elfio elf_reader;
+    if (!elf_reader.load_mapped(path)) {
+        std::cerr << "Failed to read " << path << "." << std::endl;
+        return false;
+    }
+    ELFIO::section *symtab = elf_reader.sections[".symtab"];
+    if (!symtab) {
+        std::cerr << path << " is missing symbol table." << std::endl;
+        return false;
+    }
+    ELFIO::symbol_table syms;
+    ELFIO::symbol_section_accessor sym_accessor(elf_reader, symtab);
+    sym_accessor.get_symbols(syms);
+    //Main binary symbols are absolute addresses
+    std::vector<std::vector<func_info>> funcs(1);
+    func_collect(syms, funcs, false);
+    main_funcs = std::move(funcs[0]);
+    func_sort(main_funcs, 0xFFFFFFFF);
+    return true;
+}
+
+void module_load(profile_module &module)
+{
+    //Rebuild USO section layout from source ELF
+    std::unique_ptr<uso_context> ctx(new uso_context(convert_options));
+    if (!ctx->elf_reader.load_mapped(module.src_elf_name)) {
+        std::cerr << "Failed to read " << module.src_elf_name << " so samples in " << module.name << " are not symbolized." << std::endl;
+        return;
+    }
+    elf_index_sections(*ctx);
+    if (!elf_valid(*ctx)) {
+        std::cerr << module.src_elf_name << " is not a relocatable Nintendo 64 ELF file." << std::endl;
+        return;
+    }
+    elf_read_tables(*ctx);
+    try {
+        if (convert_options.gc_sections) {
+            gc_mark_sections(*ctx);
+        }
+        section_collect(*ctx);
+    } catch (uso_error &) {
+        std::cerr << ctx->log.str();
+        return;
+    }
+    module.funcs.resize(ctx->elf_reader.sections.size());
+    func_collect(ctx->elf_syms, module.funcs, true);
+    for (size_t i = 0; i < module.funcs.size(); i++) {
+        func_sort(module.funcs[i], ctx->elf_reader.sections[i]->get_size());
+    }
+    module.ctx = std::move(ctx);
+}
+
+std::string module_symbolize(profile_module &module, uint16_t section, uint32_t offset)
+{
+    std::ostringstream unknown;
+    unknown << module.name << "+" << section << ":0x" << std::hex << offset;
+    if (!module.ctx) {
+        return unknown.str();
+    }
+    uso_context &ctx = *module.ctx;
+    if (section == 0 || section >= ctx.out_sections.size()) {
+        return unknown.str();
+    }
+    //Find input section holding offset then function inside it
+    std::vector<ELFIO::Elf_Half> &elf_sections = ctx.out_sections[section].elf_sections;
+    for (size_t i = 0; i < elf_sections.size(); i++) {
+        uint32_t base = section_get_out_base(ctx, elf_sections[i]);
+        if (offset >= base && offset - base < ctx.elf_reader.sections[elf_sections[i]]->get_size()) {
+            const func_info *func = func_find(module.funcs[elf_sections[i]], offset - base);
+            if (func) {
+                return func->name + " (" + module.name + ")";
+            }
+            break;
+        }
+    }
+    return unknown.str();
+}
+
+std::string main_symbolize(uint32_t pc)
+{
+    const func_info *func = func_find(main_funcs, pc);
+    if (func) {
+        return func->name;
+    }
+    std::ostringstream unknown;
+    unknown << "0x" << std::hex << pc;
+    return unknown.str();
+}
+
+bool dump_read(const char *path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << path << " for reading." << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        //Dump lines may be prefixed by other debug output
+        size_t start = line.find("USOPROF ");
+        if (start == std::string::npos) {
+            continue;
+        }
+        std::istringstream fields(line.substr(start + 8));
+        std::string type;
+        fields >> type;
+        if (type == "BEGIN") {
+            //Only last dump is symbolized
+            module_list.clear();
+            func_samples.clear();
+            total_samples = 0;
+        } else if (type == "MODULE") {
+            profile_module module;
+            uint32_t id;
+            fields >> id >> module.name >> module.src_elf_name;
+            if (!fields || id != module_list.size()) {
+                std::cerr << "Malformed module line in " << path << "." << std::endl;
+                return false;
+            }
+            module_load(module);
+            module_list.push_back(std::move(module));
+        } else if (type == "SAMPLE") {
+            uint32_t id, section, offset, count;
+            fields >> std::dec >> id >> section >> std::hex >> offset >> std::dec >> count;
+            if (!fields || id >= module_list.size()) {
+                std::cerr << "Malformed sample line in " << path << "." << std::endl;
+                return false;
+            }
+            func_samples[module_symbolize(module_list[id], section, offset)] += count;
+            total_samples += count;
+        } else if (type == "MAIN") {
+            uint32_t pc, count;
+            fields >> std::hex >> pc >> std::dec >> count;
+            if (!fields) {
+                std::cerr << "Malformed sample line in " << path << "." << std::endl;
+                return false;
+            }
+            func_samples[main_symbolize(pc)] += count;
+            total_samples += count;
+        }
+    }
+    return true;
+}
+
+bool func_sample_compare(const std::pair<std::string, uint32_t> &first, const std::pair<std::string, uint32_t> &second)
+{
+    //Most sampled functions come first with ties in name order
+    if (first.second != second.second) {
+        return first.second > second.second;
+    }
+    return first.first < second.first;
+}
+
+void print_profile()
+{
+    std::vector<std::pair<std::string, uint32_t>> funcs(func_samples.begin(), func_samples.end());
+    std::sort(funcs.begin(), funcs.end(), func_sample_compare);
+    for (size_t i = 0; i < funcs.size(); i++) {
+        printf("%8u %6.2f%% %s\n", funcs[i].second, (funcs[i].second * 100.0) / total_samples, funcs[i].first.c_str());
+    }
+}
+
+void print_usage(char *name)
+{
+    std::cout << "Usage: " << name << " [-c [-e export_list]] [-d] [-m main_elf] dump" << std::endl;
+    std::cout << "dump is debug output containing the output of uso_profile_dump." << std::endl;
+    std::cout << "Samples are counted per function, most sampled first." << std::endl;
+    std::cout << "Samples in USOs are symbolized with the source ELF each USO was converted from." << std::endl;
+    std::cout << "-c must be passed if USOs were converted with -c." << std::endl;
+    std::cout << "-e export_list must also be passed if USOs were converted with -c and -e export_list." << std::endl;
+    std::cout << "-d must be passed if USOs were linked with uso_ld -w, which writes the ELF they record." << std::endl;
+    std::cout << "Samples outside USOs are symbolized with main_elf." << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    int arg_idx = 1;
+    const char *main_elf_path = NULL;
+    //Parse options
+    while (arg_idx < argc && argv[arg_idx][0] == '-') {
+        std::string option = argv[arg_idx++];
+        if (option == "-c") {
+            convert_options.gc_sections = true;
+            convert_options.merge_sections = true;
+        } else if (option == "-d") {
+            //uso_ld merges linked sections the same way as -c
+            convert_options.merge_sections = true;
+        } else if (option == "-m" && arg_idx < argc) {
+            main_elf_path = argv[arg_idx++];
+        } else if (option == "-e" && arg_idx < argc) {
+            //Pruned exports change which sections -c removes
+            if (!export_list_read(convert_options, argv[arg_idx++])) {
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - arg_idx != 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (main_elf_path && !main_elf_read(main_elf_path)) {
+        return 1;
+    }
+    if (!dump_read(argv[arg_idx])) {
+        return 1;
+    }
+    print_profile();
+    return 0;
+}